@@ -0,0 +1,113 @@
+/******************************************************************************
+* File Name:   main.c
+*
+* Description: Linux entry point that runs the streaming protocol without a
+*              board, through the file or UDP transport. Used to benchmark
+*              the protocol with tools/bench_receiver.py; see host/Makefile.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "protocol.h"
+#include "streaming.h"
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define HOST_POLL_INTERVAL_US       (100u)
+/* Time the main loop sleeps between polls of the transport */
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Selects the transport given on the command line, then handles commands
+*  from the host until the process is stopped. No sensors are started, so
+*  the host gets the responses to its commands but no sensor data;
+*  `bench,<bytes>,<chunk>` measures the send path and the link.
+*
+*  Usage: streamer [<path> | udp]
+*  Without arguments, the file transport creates a pseudo-terminal and prints
+*  its name. A path streams through that file or device instead, and `udp`
+*  listens on STREAMING_UDP_PORT.
+*
+* Parameters:
+*  argc: number of arguments
+*  argv: arguments
+*
+* Return:
+*  1 on invalid arguments; does not return otherwise.
+*
+*******************************************************************************/
+int main(int argc, char** argv)
+{
+    if (argc > 2)
+    {
+        fprintf(stderr, "usage: %s [<path> | udp]\n", argv[0]);
+        return 1;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "udp") == 0)
+    {
+        streaming_select("udp");
+    }
+    else
+    {
+        streaming_select("file");
+        if (argc > 1)
+        {
+            streaming_file_set_path(argv[1]);
+        }
+    }
+
+    streaming_init();
+    protocol_init();
+
+    for (;;)
+    {
+        /* Handle incoming commands, including bench */
+        protocol_repl();
+        usleep(HOST_POLL_INTERVAL_US);
+    }
+}
+
+/* [] END OF FILE */
@@ -40,7 +40,10 @@
 #include "cyhal.h"
 #include "cybsp.h"
 #include "audio.h"
+#include "clock.h"
 #include "config.h"
+#include "protocol.h"
+#include "sensor.h"
 
 
 /******************************************************************************
@@ -64,6 +67,13 @@ int16_t audio_buffer1[FRAME_SIZE] = {0};
 int16_t* active_rx_buffer;
 int16_t* full_rx_buffer;
 
+/* Frames overwritten because the main loop had not picked up the previous
+ * one yet */
+volatile uint32_t pdm_overruns = 0;
+
+/* Time in us when the last frame in full_rx_buffer was completed */
+volatile uint32_t pdm_frame_time = 0;
+
 
 /******************************************************************************
  * Global Variables
@@ -73,6 +83,24 @@ cyhal_pdm_pcm_t pdm_pcm;
 cyhal_clock_t   audio_clock;
 cyhal_clock_t   pll_clock;
 
+/* Rates, shape and batch sizes advertised to the host. The batch sizes
+ * divide FRAME_SIZE, so frames are only ever cut into packets. */
+static const uint32_t pdm_rates[] = { SAMPLE_RATE_HZ };
+static const uint16_t pdm_batch_sizes[] = { FRAME_SIZE / 8, FRAME_SIZE / 4, FRAME_SIZE / 2, FRAME_SIZE };
+static const sensor_t pdm_sensor =
+{
+    .channel          = PROTOCOL_AUDIO_CHANNEL,
+    .type             = "microphone",
+    .datatype         = "s16",
+    .samples          = FRAME_SIZE,
+    .features         = 1,
+    .rates            = pdm_rates,
+    .rate_count       = sizeof(pdm_rates) / sizeof(pdm_rates[0]),
+    .batch_sizes      = pdm_batch_sizes,
+    .batch_size_count = sizeof(pdm_batch_sizes) / sizeof(pdm_batch_sizes[0]),
+    .batch_buffer     = NULL,
+};
+
 /* HAL PDM Configuration */
 const cyhal_pdm_pcm_cfg_t pdm_pcm_cfg =
 {
@@ -150,6 +178,9 @@ cy_rslt_t pdm_init(void)
     /* Start an asynchronous read */
     cyhal_pdm_pcm_read_async(&pdm_pcm, active_rx_buffer, FRAME_SIZE);
 
+    /* Make the microphone available to the host */
+    sensor_register(&pdm_sensor);
+
     return CY_RSLT_SUCCESS;
 }
 
@@ -233,17 +264,48 @@ void pdm_pcm_event_handler(void *arg, cyhal_pdm_pcm_event_t event)
     if(false == pdm_pcm_flag)
     {
         pdm_pcm_flag = true;
+        pdm_frame_time = clock_now_us();
 
         /* Flip the active and the next rx buffers */
         int16_t* temp = active_rx_buffer;
         active_rx_buffer = full_rx_buffer;
         full_rx_buffer = temp;
-
+    }
+    else
+    {
+        /* The previous frame has not been processed; this one is lost */
+        pdm_overruns++;
     }
     /* Initiate the next pdm read */
     cyhal_pdm_pcm_read_async(&pdm_pcm, active_rx_buffer, FRAME_SIZE);
 }
 
+/*******************************************************************************
+* Function Name: pdm_get_overruns
+********************************************************************************
+* Summary:
+*  Returns the number of frames lost because the main loop did not pick up
+*  the previous frame in time.
+*
+*******************************************************************************/
+uint32_t pdm_get_overruns(void)
+{
+    return pdm_overruns;
+}
+
+/*******************************************************************************
+* Function Name: pdm_get_frame_time
+********************************************************************************
+* Summary:
+*  Returns the time in us when the capture of the current frame was
+*  completed, see clock_now_us().
+*
+*******************************************************************************/
+uint32_t pdm_get_frame_time(void)
+{
+    return pdm_frame_time;
+}
+
 /*******************************************************************************
 * Function Name: pdm_preprocessing_feed
 ********************************************************************************
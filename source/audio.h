@@ -37,6 +37,8 @@
 #ifndef SOURCE_AUDIO_H_
 #define SOURCE_AUDIO_H_
 
+#include <stdint.h>
+#include "cy_result.h"
 #include "stdbool.h"
 
 /******************************************************************************
@@ -54,6 +56,8 @@ extern volatile bool pdm_pcm_flag;
 *******************************************************************************/
 cy_rslt_t pdm_init(void);
 void pdm_preprocessing_feed(int16_t *preprocessed_data);
+uint32_t pdm_get_overruns(void);
+uint32_t pdm_get_frame_time(void);
 
 
 #endif /* SOURCE_AUDIO_H_ */
@@ -0,0 +1,189 @@
+/******************************************************************************
+* File Name:   backpressure.c
+*
+* Description: This file implements the policy that decides which sensor
+*              packets are sent when the transport cannot keep up.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include "backpressure.h"
+#include "protocol.h"
+#include "streaming.h"
+
+/* BACKPRESSURE
+ * ============
+ * Before a sensor packet is queued, backpressure_admit() checks the transmit
+ * queue of the transport. A packet that does not fit in the free space is
+ * always dropped, so a sensor packet never stalls the main loop. While the
+ * queue is above the high watermark (see streaming_is_congested()), each
+ * channel is degraded according to its policy: audio drops whole frames,
+ * which the host can detect as gaps, and the IMU sends at a reduced rate.
+ * Every decision is counted and reported by the stats? command. */
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define BACKPRESSURE_DECIMATION     (5u)
+/* Keep one in this many packets of a decimated channel while congested */
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+static backpressure_stats_t channel_stats[BACKPRESSURE_MAX_CHANNEL + 1];
+static uint32_t             channel_decimation[BACKPRESSURE_MAX_CHANNEL + 1];
+
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static backpressure_policy_t backpressure_get_policy(uint8_t channel);
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: backpressure_admit
+********************************************************************************
+* Summary:
+*  Decides whether a packet should be sent, and counts the decision.
+*
+* Parameters:
+*  channel: the channel of the packet
+*  size: total size of the packet including header and trailer
+*
+* Return:
+*  True if the packet should be sent; false if it is dropped.
+*
+*******************************************************************************/
+bool backpressure_admit(uint8_t channel, size_t size)
+{
+    backpressure_stats_t* stats;
+
+    stats = &channel_stats[channel];
+
+    /* Never block on a full queue; the channel may have a queue of its own */
+    if (streaming_get_free(channel) < size)
+    {
+        stats->dropped++;
+        return false;
+    }
+
+    if (streaming_is_congested())
+    {
+        switch (backpressure_get_policy(channel))
+        {
+        case BACKPRESSURE_DROP:
+            stats->dropped++;
+            return false;
+
+        case BACKPRESSURE_DECIMATE:
+            if (channel_decimation[channel]++ % BACKPRESSURE_DECIMATION != 0)
+            {
+                stats->decimated++;
+                return false;
+            }
+            break;
+
+        case BACKPRESSURE_KEEP:
+            break;
+        }
+    }
+    else
+    {
+        channel_decimation[channel] = 0;
+    }
+
+    stats->sent++;
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: backpressure_set_overruns
+********************************************************************************
+* Summary:
+*  Records the number of frames a sensor driver has lost so far, e.g.
+*  because the main loop did not pick up a frame in time.
+*
+* Parameters:
+*  channel: the channel of the sensor
+*  overruns: total number of frames lost
+*
+*******************************************************************************/
+void backpressure_set_overruns(uint8_t channel, uint32_t overruns)
+{
+    channel_stats[channel].overruns = overruns;
+}
+
+/*******************************************************************************
+* Function Name: backpressure_get_stats
+********************************************************************************
+* Summary:
+*  Returns the packet accounting of a channel.
+*
+* Parameters:
+*  channel: the channel
+*  stats: pointer to where the statistics will be stored
+*
+*******************************************************************************/
+void backpressure_get_stats(uint8_t channel, backpressure_stats_t* stats)
+{
+    *stats = channel_stats[channel];
+}
+
+/*******************************************************************************
+* Function Name: backpressure_get_policy
+********************************************************************************
+* Summary:
+*  Returns the policy of a channel while the link is congested.
+*
+*******************************************************************************/
+static backpressure_policy_t backpressure_get_policy(uint8_t channel)
+{
+    switch (channel)
+    {
+    case PROTOCOL_AUDIO_CHANNEL:
+        return BACKPRESSURE_DROP;
+    case PROTOCOL_IMU_CHANNEL:
+    case PROTOCOL_GYRO_CHANNEL:
+        return BACKPRESSURE_DECIMATE;
+    default:
+        return BACKPRESSURE_KEEP;
+    }
+}
+
+/* [] END OF FILE */
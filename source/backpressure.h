@@ -0,0 +1,79 @@
+/******************************************************************************
+* File Name:   backpressure.h
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifndef SOURCE_BACKPRESSURE_H_
+#define SOURCE_BACKPRESSURE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define BACKPRESSURE_MAX_CHANNEL    (255u)
+/* Highest channel number; every channel has its own accounting */
+
+/*******************************************************************************
+* Type Definitions
+*******************************************************************************/
+/* What happens to the packets of a channel while the link is congested */
+typedef enum
+{
+    BACKPRESSURE_KEEP,       /* Send all packets; the sender may have to wait */
+    BACKPRESSURE_DROP,       /* Drop whole packets */
+    BACKPRESSURE_DECIMATE,   /* Send only every BACKPRESSURE_DECIMATION-th packet */
+} backpressure_policy_t;
+
+/* Packet accounting of one channel */
+typedef struct
+{
+    uint32_t sent;        /* Packets passed on to the transport */
+    uint32_t dropped;     /* Packets dropped because the queue was full or congested */
+    uint32_t decimated;   /* Packets skipped to reduce the rate while congested */
+    uint32_t overruns;    /* Frames lost at the source before reaching the protocol */
+} backpressure_stats_t;
+
+/*******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+bool backpressure_admit(uint8_t channel, size_t size);
+void backpressure_set_overruns(uint8_t channel, uint32_t overruns);
+void backpressure_get_stats(uint8_t channel, backpressure_stats_t* stats);
+
+#endif /* SOURCE_BACKPRESSURE_H_ */
+
+/* [] END OF FILE */
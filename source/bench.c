@@ -0,0 +1,158 @@
+/******************************************************************************
+* File Name:   bench.c
+*
+* Description: This file implements the link benchmark of the bench command: it
+*              streams a generated pattern through the real send path as fast as
+*              the transport takes it and reports what the device spent on it.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "clock.h"
+#include "protocol.h"
+#include "streaming.h"
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define BENCH_REPORT_SIZE           (320u)
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+static uint8_t chunk_buffer[BENCH_MAX_CHUNK];
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: bench_run
+********************************************************************************
+* Summary:
+*  Sends the given number of payload bytes on PROTOCOL_BENCH_CHANNEL in
+*  packets of the given chunk size (the last one may be shorter), in the
+*  current framing, then sends a report. Each chunk starts with its
+*  sequence number and the time it was queued, followed by the pattern 0,
+*  1, 2, ... 255, 0, ... The main loop is blocked until all data has been
+*  sent.
+*
+*  The report gives the elapsed time, the time spent in the send path and
+*  the part of it spent waiting for queue space, the CPU cycles per byte of
+*  the send path (including the framing) without the waiting, and the
+*  achieved throughput.
+*
+* Parameters:
+*  bytes: total number of payload bytes to send
+*  chunk: payload size of each packet, BENCH_HEADER_SIZE to BENCH_MAX_CHUNK
+*
+*******************************************************************************/
+void bench_run(uint32_t bytes, uint32_t chunk)
+{
+    static char report[BENCH_REPORT_SIZE];
+    uint64_t send_cycles = 0;
+    uint64_t stall_cycles = 0;
+    uint32_t sequence = 0;
+    uint32_t sent = 0;
+
+    /* The pattern is the same for every chunk */
+    for (uint32_t i = BENCH_HEADER_SIZE; i < chunk; i++)
+    {
+        chunk_buffer[i] = (uint8_t)(i - BENCH_HEADER_SIZE);
+    }
+
+    clock_update();
+    uint32_t start_us = clock_get_us();
+
+    while (sent < bytes)
+    {
+        uint32_t size = bytes - sent < chunk ? bytes - sent : chunk;
+        if (size < BENCH_HEADER_SIZE)
+        {
+            size = BENCH_HEADER_SIZE;
+        }
+
+        clock_update();
+        uint32_t now_us = clock_get_us();
+        memcpy(chunk_buffer, &sequence, sizeof(sequence));
+        memcpy(chunk_buffer + sizeof(sequence), &now_us, sizeof(now_us));
+
+        /* A send that finds the queue without room for the packet has to
+         * wait for the link; its time counts as stall time */
+        bool stall = streaming_get_free(PROTOCOL_BENCH_CHANNEL) < protocol_frame_size(size);
+
+        uint32_t cycles = clock_get_cycles();
+        protocol_send_frame(PROTOCOL_BENCH_CHANNEL, chunk_buffer, size, now_us);
+        cycles = clock_get_cycles() - cycles;
+
+        send_cycles += cycles;
+        if (stall)
+        {
+            stall_cycles += cycles;
+        }
+        sent += size;
+        sequence++;
+    }
+
+    streaming_flush();
+    clock_update();
+    uint32_t elapsed_us = clock_get_us() - start_us;
+
+    uint32_t cycles_per_us = clock_get_cycle_frequency() / 1000000u;
+    uint32_t cycles_per_byte = sent ? (uint32_t)((send_cycles - stall_cycles) / sent) : 0;
+    uint32_t bytes_per_s = elapsed_us ? (uint32_t)((uint64_t)sent * 1000000u / elapsed_us) : 0;
+    snprintf(report, sizeof(report),
+            "{\r\n"
+            "    \"bench\": {\r\n"
+            "        \"bytes\": %lu,\r\n"
+            "        \"chunks\": %lu,\r\n"
+            "        \"elapsed_us\": %lu,\r\n"
+            "        \"send_us\": %lu,\r\n"
+            "        \"stall_us\": %lu,\r\n"
+            "        \"cycles_per_byte\": %lu,\r\n"
+            "        \"bytes_per_s\": %lu\r\n"
+            "    }\r\n"
+            "}\r\n",
+            (unsigned long)sent, (unsigned long)sequence, (unsigned long)elapsed_us,
+            (unsigned long)(send_cycles / cycles_per_us), (unsigned long)(stall_cycles / cycles_per_us),
+            (unsigned long)cycles_per_byte, (unsigned long)bytes_per_s);
+    protocol_send_text(report);
+}
+
+/* [] END OF FILE */
@@ -1,7 +1,8 @@
 /******************************************************************************
 * File Name:   clock.c
 *
-* Description: This file provides a simple millisecond clock.
+* Description: This file provides a simple millisecond clock, with a
+*              microsecond variant and a CPU cycle counter for profiling.
 *
 *
 *******************************************************************************
@@ -37,9 +38,65 @@
 * so agrees to indemnify Cypress against all liability.
 *******************************************************************************/
 
-#include "cyhal.h"
 #include "clock.h"
 
+#ifdef __linux__
+
+/* Host build: the clock is based on CLOCK_MONOTONIC */
+#include <time.h>
+
+static uint64_t start_us = 0;
+static uint64_t now_us = 0;
+
+static uint64_t clock_read_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000u;
+}
+
+void clock_init()
+{
+    start_us = clock_read_us();
+}
+
+void clock_update()
+{
+    now_us = clock_read_us() - start_us;
+}
+
+uint32_t clock_get_ms()
+{
+    return (uint32_t)(now_us / 1000u);
+}
+
+uint32_t clock_get_us()
+{
+    return (uint32_t)now_us;
+}
+
+uint32_t clock_now_us()
+{
+    return (uint32_t)(clock_read_us() - start_us);
+}
+
+/* There is no portable cycle counter; count nanoseconds instead */
+uint32_t clock_get_cycles()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec);
+}
+
+uint32_t clock_get_cycle_frequency()
+{
+    return 1000000000u;
+}
+
+#else
+
+#include "cyhal.h"
+
 
 /*******************************************************************************
 * Static Variables
@@ -74,6 +131,11 @@ void clock_init()
     cyhal_timer_set_frequency(&timer_obj, 10000);
     /* Start the timer with the configured settings */
     cyhal_timer_start(&timer_obj);
+
+    /* Enable the DWT cycle counter */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 }
 
 void clock_update()
@@ -90,3 +152,35 @@ uint32_t clock_get_ms()
 {
     return 1000 * seconds + last_t / 10;
 }
+
+/* Resolution is one timer tick, 100 us */
+uint32_t clock_get_us()
+{
+    return 1000000 * seconds + last_t * 100;
+}
+
+/* Reads the timer instead of the time of the last clock_update(), so it may
+ * be used to timestamp events in interrupt handlers */
+uint32_t clock_now_us()
+{
+    size_t t = cyhal_timer_read(&timer_obj);
+    size_t s = seconds;
+    if (t < last_t)
+    {
+        /* The timer wrapped since the last clock_update() */
+        s++;
+    }
+    return 1000000 * s + t * 100;
+}
+
+uint32_t clock_get_cycles()
+{
+    return DWT->CYCCNT;
+}
+
+uint32_t clock_get_cycle_frequency()
+{
+    return SystemCoreClock;
+}
+
+#endif
@@ -42,5 +42,9 @@
 void clock_init();
 void clock_update();
 uint32_t clock_get_ms();
+uint32_t clock_get_us();
+uint32_t clock_now_us();
+uint32_t clock_get_cycles();
+uint32_t clock_get_cycle_frequency();
 
 #endif /* SOURCE_CLOCK_H_ */
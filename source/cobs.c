@@ -0,0 +1,158 @@
+/******************************************************************************
+* File Name:   cobs.c
+*
+* Description: This file implements Consistent Overhead Byte Stuffing (COBS), which
+*              removes all zero bytes from a frame so that a zero byte can mark the
+*              end of the frame.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#include <string.h>
+#include "cobs.h"
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define COBS_MAX_BLOCK              (255u)
+/* Largest block: the code byte and 254 data bytes */
+#define COBS_HAS_ZERO(w)            (((w) - 0x01010101u) & ~(w) & 0x80808080u)
+/* Nonzero if any byte of the 32-bit word w is zero */
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: cobs_begin
+********************************************************************************
+* Summary:
+*  Starts encoding a frame.
+*
+* Parameters:
+*  encoder: the encoder state
+*  out: buffer for the encoded frame, see COBS_MAX_ENCODED_SIZE()
+*
+*******************************************************************************/
+void cobs_begin(cobs_encoder_t* encoder, uint8_t* out)
+{
+    encoder->start = out;
+    encoder->code = out;
+    encoder->out = out + 1;
+}
+
+/*******************************************************************************
+* Function Name: cobs_update
+********************************************************************************
+* Summary:
+*  Encodes the next bytes of the frame. Runs without zero bytes are scanned
+*  and copied a word at a time; the data needs no particular alignment.
+*
+* Parameters:
+*  encoder: the encoder state
+*  data: pointer to the bytes
+*  size: number of bytes
+*
+*******************************************************************************/
+void cobs_update(cobs_encoder_t* encoder, const void* data, size_t size)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    const uint8_t* end = p + size;
+    uint8_t* code = encoder->code;
+    uint8_t* out = encoder->out;
+
+    while (p < end)
+    {
+        /* Copy whole words while they contain no zero and fit in the block */
+        while (end - p >= 4 && out - code <= (ptrdiff_t)COBS_MAX_BLOCK - 4)
+        {
+            uint32_t word;
+            memcpy(&word, p, sizeof(word));
+            if (COBS_HAS_ZERO(word))
+            {
+                break;
+            }
+            memcpy(out, &word, sizeof(word));
+            out += 4;
+            p += 4;
+        }
+
+        /* Then go on byte by byte up to the next zero or the end of the block */
+        if (p < end && out - code < (ptrdiff_t)COBS_MAX_BLOCK)
+        {
+            uint8_t byte = *p++;
+            if (byte == 0)
+            {
+                *code = (uint8_t)(out - code);
+                code = out++;
+                continue;
+            }
+            *out++ = byte;
+        }
+
+        /* A full block ends without an implied zero */
+        if (out - code == (ptrdiff_t)COBS_MAX_BLOCK)
+        {
+            *code = COBS_MAX_BLOCK;
+            code = out++;
+        }
+    }
+
+    encoder->code = code;
+    encoder->out = out;
+}
+
+/*******************************************************************************
+* Function Name: cobs_end
+********************************************************************************
+* Summary:
+*  Ends the frame and appends the zero delimiter.
+*
+* Parameters:
+*  encoder: the encoder state
+*
+* Return:
+*  The size of the encoded frame, including the delimiter.
+*
+*******************************************************************************/
+size_t cobs_end(cobs_encoder_t* encoder)
+{
+    *encoder->code = (uint8_t)(encoder->out - encoder->code);
+    *encoder->out++ = 0;
+    return encoder->out - encoder->start;
+}
+
+/* [] END OF FILE */
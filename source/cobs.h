@@ -0,0 +1,76 @@
+/******************************************************************************
+* File Name:   cobs.h
+*
+* Description: This file contains the interface of the COBS encoder used by the
+*              self-synchronizing packet framing.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#ifndef SOURCE_COBS_H_
+#define SOURCE_COBS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define COBS_MAX_ENCODED_SIZE(n)    ((n) + (n) / 254u + 2u)
+/* Worst case size of n bytes after encoding, including the delimiter */
+
+/*******************************************************************************
+* Type Definitions
+*******************************************************************************/
+/* State of an encoding in progress */
+typedef struct
+{
+    uint8_t* start;     /* First byte of the output */
+    uint8_t* code;      /* Code byte of the current block */
+    uint8_t* out;       /* Next output byte */
+} cobs_encoder_t;
+
+/*******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+/* Consistent Overhead Byte Stuffing: the encoded data contains no zero bytes,
+ * so a zero byte can delimit frames. A frame is encoded from several buffers
+ * with cobs_begin(), cobs_update() for each buffer and cobs_end(). */
+void cobs_begin(cobs_encoder_t* encoder, uint8_t* out);
+void cobs_update(cobs_encoder_t* encoder, const void* data, size_t size);
+size_t cobs_end(cobs_encoder_t* encoder);
+
+#endif /* SOURCE_COBS_H_ */
+
+/* [] END OF FILE */
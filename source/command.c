@@ -0,0 +1,329 @@
+/******************************************************************************
+* File Name:   command.c
+*
+* Description: This file parses commands received from the host and dispatches
+*              them to their handlers through a table keyed by verb.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#include <stdbool.h>
+#include <string.h>
+#include "command.h"
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define FNV_OFFSET_BASIS            (2166136261u)
+#define FNV_PRIME                   (16777619u)
+/* Parameters of the 32-bit FNV-1a hash */
+
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static uint32_t command_hash(const char* verb);
+static const command_t* command_find(const command_table_t* table, const char* verb);
+static size_t command_tokenize(char* line, char** tokens, size_t max_tokens);
+static bool command_parse_uint(const char* token, uint32_t* value);
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: command_table_init
+********************************************************************************
+* Summary:
+*  Builds the hash index of a command table. Call this once before passing
+*  the table to command_execute() or command_execute_code().
+*
+* Parameters:
+*  table: the table to build
+*  commands: the commands; must stay valid while the table is used
+*  count: number of commands, less than COMMAND_TABLE_SLOTS
+*
+*******************************************************************************/
+void command_table_init(command_table_t* table, const command_t* commands, size_t count)
+{
+    table->commands = commands;
+    table->count = count;
+    memset(table->slots, 0, sizeof(table->slots));
+    for (size_t i = 0; i < count && i < COMMAND_TABLE_SLOTS - 1; i++)
+    {
+        /* Open addressing with linear probing */
+        uint32_t slot = command_hash(commands[i].verb) & (COMMAND_TABLE_SLOTS - 1);
+        while (table->slots[slot])
+        {
+            slot = (slot + 1) & (COMMAND_TABLE_SLOTS - 1);
+        }
+        table->slots[slot] = (uint8_t)(i + 1);
+    }
+}
+
+/*******************************************************************************
+* Function Name: command_execute
+********************************************************************************
+* Summary:
+*  Splits a command line into the verb and comma separated arguments, checks
+*  and converts the arguments and calls the handler of the command.
+*
+* Parameters:
+*  table: the commands
+*  line: the command line, without the trailing \r\n; it is modified
+*
+* Return:
+*  COMMAND_OK if the handler was called.
+*
+*******************************************************************************/
+command_result_t command_execute(const command_table_t* table, char* line)
+{
+    char* tokens[COMMAND_MAX_ARGS + 2];
+    command_arg_t args[COMMAND_MAX_ARGS];
+
+    /* One token more than the verb and the arguments, to find extra ones */
+    size_t count = command_tokenize(line, tokens, COMMAND_MAX_ARGS + 2) - 1;
+
+    const command_t* command = command_find(table, tokens[0]);
+    if (command == NULL)
+    {
+        return COMMAND_UNRECOGNIZED;
+    }
+
+    const char* type = command->args;
+    bool optional = false;
+    size_t n = 0;
+    for (; *type; type++)
+    {
+        if (*type == '?')
+        {
+            optional = true;
+            continue;
+        }
+        if (n == count)
+        {
+            break;
+        }
+        if (*type == 'u')
+        {
+            if (!command_parse_uint(tokens[n + 1], &args[n].u))
+            {
+                return COMMAND_INVALID_ARGUMENT;
+            }
+        }
+        else
+        {
+            args[n].s = tokens[n + 1];
+        }
+        n++;
+    }
+
+    /* Too many arguments, or a required one is missing */
+    if (n < count || (*type && *type != '?' && !optional))
+    {
+        return COMMAND_INVALID_ARGUMENT;
+    }
+
+    command->handler(args, n);
+    return COMMAND_OK;
+}
+
+/*******************************************************************************
+* Function Name: command_execute_code
+********************************************************************************
+* Summary:
+*  Checks arguments that arrived already converted, e.g. in a binary
+*  request, and calls the handler of the command with the given code.
+*
+* Parameters:
+*  table: the commands
+*  code: the code of the command, see command_t
+*  types: the type of each argument, 'u' or 's'
+*  args: the arguments
+*  count: number of arguments
+*
+* Return:
+*  COMMAND_OK if the handler was called.
+*
+*******************************************************************************/
+command_result_t command_execute_code(const command_table_t* table, uint8_t code, const char* types,
+                                      const command_arg_t* args, size_t count)
+{
+    const command_t* command = NULL;
+    for (size_t i = 0; i < table->count && code != 0; i++)
+    {
+        if (table->commands[i].code == code)
+        {
+            command = &table->commands[i];
+            break;
+        }
+    }
+    if (command == NULL)
+    {
+        return COMMAND_UNRECOGNIZED;
+    }
+
+    const char* type = command->args;
+    bool optional = false;
+    size_t n = 0;
+    for (; *type; type++)
+    {
+        if (*type == '?')
+        {
+            optional = true;
+            continue;
+        }
+        if (n == count)
+        {
+            break;
+        }
+        if (types[n] != *type)
+        {
+            return COMMAND_INVALID_ARGUMENT;
+        }
+        n++;
+    }
+
+    /* Too many arguments, or a required one is missing */
+    if (n < count || (*type && *type != '?' && !optional))
+    {
+        return COMMAND_INVALID_ARGUMENT;
+    }
+
+    command->handler(args, n);
+    return COMMAND_OK;
+}
+
+/*******************************************************************************
+* Function Name: command_hash
+********************************************************************************
+* Summary:
+*  Returns the FNV-1a hash of a verb.
+*
+*******************************************************************************/
+static uint32_t command_hash(const char* verb)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+    while (*verb)
+    {
+        hash = (hash ^ (uint8_t)*verb++) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/*******************************************************************************
+* Function Name: command_find
+********************************************************************************
+* Summary:
+*  Looks up a command by its verb.
+*
+* Return:
+*  The command, or NULL if there is none with this verb.
+*
+*******************************************************************************/
+static const command_t* command_find(const command_table_t* table, const char* verb)
+{
+    uint32_t slot = command_hash(verb) & (COMMAND_TABLE_SLOTS - 1);
+    while (table->slots[slot])
+    {
+        const command_t* command = &table->commands[table->slots[slot] - 1];
+        if (strcmp(command->verb, verb) == 0)
+        {
+            return command;
+        }
+        slot = (slot + 1) & (COMMAND_TABLE_SLOTS - 1);
+    }
+    return NULL;
+}
+
+/*******************************************************************************
+* Function Name: command_tokenize
+********************************************************************************
+* Summary:
+*  Splits a line at commas, in place. Once max_tokens is reached, the rest of
+*  the line is the last token.
+*
+* Return:
+*  The number of tokens; at least 1, as an empty line is one empty token.
+*
+*******************************************************************************/
+static size_t command_tokenize(char* line, char** tokens, size_t max_tokens)
+{
+    size_t count = 0;
+    tokens[count++] = line;
+    for (char* p = line; *p && count < max_tokens; p++)
+    {
+        if (*p == ',')
+        {
+            *p = 0;
+            tokens[count++] = p + 1;
+        }
+    }
+    return count;
+}
+
+/*******************************************************************************
+* Function Name: command_parse_uint
+********************************************************************************
+* Summary:
+*  Converts a decimal unsigned integer argument.
+*
+* Return:
+*  False if the token is empty, has other characters than digits or does not
+*  fit in 32 bits.
+*
+*******************************************************************************/
+static bool command_parse_uint(const char* token, uint32_t* value)
+{
+    uint32_t v = 0;
+    if (*token == 0)
+    {
+        return false;
+    }
+    for (; *token; token++)
+    {
+        uint32_t digit = (uint32_t)(*token - '0');
+        if (digit > 9 || v > (UINT32_MAX - digit) / 10)
+        {
+            return false;
+        }
+        v = v * 10 + digit;
+    }
+    *value = v;
+    return true;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,101 @@
+/******************************************************************************
+* File Name:   command.h
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#ifndef SOURCE_COMMAND_H_
+#define SOURCE_COMMAND_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define COMMAND_MAX_ARGS            (4u)
+/* Most arguments a command takes */
+#define COMMAND_TABLE_SLOTS         (32u)
+/* Hash slots of a command table; a power of two above the number of commands */
+
+/*******************************************************************************
+* Type Definitions
+*******************************************************************************/
+/* A typed argument. Its type is given by the argument list of the command. */
+typedef union
+{
+    uint32_t    u;      /* 'u': decimal unsigned integer */
+    const char* s;      /* 's': string */
+} command_arg_t;
+
+/* A command: the verb, its code in binary requests (0 if it has none), the
+ * types of its arguments and its handler. The argument list has one
+ * character per argument, 'u' or 's'; arguments after a '?' are optional,
+ * e.g. "?u" for one optional integer. The handler gets the parsed arguments
+ * and their number. */
+typedef struct
+{
+    const char* verb;
+    uint8_t     code;
+    const char* args;
+    void (*handler)(const command_arg_t* args, size_t count);
+} command_t;
+
+/* Commands indexed by the hash of their verb */
+typedef struct
+{
+    const command_t* commands;
+    size_t  count;
+    uint8_t slots[COMMAND_TABLE_SLOTS];     /* Index + 1 of a command; 0 if free */
+} command_table_t;
+
+/* Outcome of command_execute() */
+typedef enum
+{
+    COMMAND_OK,
+    COMMAND_UNRECOGNIZED,       /* No command with this verb */
+    COMMAND_INVALID_ARGUMENT,   /* Wrong number or type of arguments */
+} command_result_t;
+
+/*******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+void command_table_init(command_table_t* table, const command_t* commands, size_t count);
+command_result_t command_execute(const command_table_t* table, char* line);
+command_result_t command_execute_code(const command_table_t* table, uint8_t code, const char* types,
+                                      const command_arg_t* args, size_t count);
+
+#endif /* SOURCE_COMMAND_H_ */
+
+/* [] END OF FILE */
@@ -73,4 +73,67 @@
 /* Change below to SAMPLE_RATE_8_KHZ or SAMPLE_RATE_16_KHZ */
 #define PDM_SAMPLE_RATE SAMPLE_RATE_16_KHZ
 
+/* Set to 1 to also expose the microphone as a USB Audio Class device next to
+ * the CDC interface. Requires the USBD_BASE component. Off by default, since
+ * the board then enumerates as a composite device. */
+#define IM_ENABLE_USB_AUDIO 0
+
+/* Set to 1 to add a vendor-class interface with one bulk IN endpoint per
+ * channel in USB_ENDPOINT_CHANNELS, each with its own transmit queue, so a
+ * large audio packet does not delay IMU packets. The config response reports
+ * the endpoint of each channel. Requires a host driver for the vendor
+ * interface (e.g. libusb/WinUSB); the CDC interface is kept for commands. */
+#define IM_ENABLE_USB_CHANNEL_ENDPOINTS 0
+
+/* Channels (audio, IMU) that get their own endpoint when
+ * IM_ENABLE_USB_CHANNEL_ENDPOINTS is set */
+#define USB_ENDPOINT_CHANNELS { 1, 2 }
+
+/* Set to 1 to stream over UDP on the onboard Wi-Fi radio. Requires the
+ * wifi-connection-manager library and the FREERTOS, LWIP and MBEDTLS
+ * components, see README.md. */
+#define IM_ENABLE_WIFI 0
+
+/* Access point to join and local UDP port to listen on. The host is the
+ * sender of the most recent command datagram. */
+#define WIFI_SSID               "MY_WIFI_SSID"
+#define WIFI_PASSWORD           "MY_WIFI_PASSWORD"
+#define WIFI_SECURITY           CY_WCM_SECURITY_WPA2_AES_PSK
+#define STREAMING_UDP_PORT      5005
+
+/* Backlogs for channels under credit-based flow control, see credit.c: at
+ * most CREDIT_BACKLOG_SLOTS channels at once, each holding up to
+ * CREDIT_BACKLOG_SIZE bytes of packets waiting for credit. Together they take
+ * CREDIT_BACKLOG_SLOTS x CREDIT_BACKLOG_SIZE bytes of SRAM. */
+#define CREDIT_BACKLOG_SLOTS    2
+#define CREDIT_BACKLOG_SIZE     8192
+
+/* Channels whose most recent packets are kept for the resend command, see
+ * history.c, and the bytes kept per channel. A packet takes its payload plus
+ * 12 bytes, so the default keeps 3 audio frames or 340 IMU packets; the
+ * histories take HISTORY_SIZE bytes of SRAM per channel. */
+#define HISTORY_CHANNELS        { 1, 2 }
+#define HISTORY_SIZE            8192
+
+/* Transmit scheduler for the v2 and cobs framings, see scheduler.c: the
+ * channels with a queue of their own and its size in bytes (SRAM per
+ * channel; a queue also holds at most 64 packets), and how many bytes the
+ * scheduler lets wait in the transmit queue of the transport. Less data
+ * waiting in the transport means less delay for a packet that the scheduler
+ * picks ahead of others. */
+#define SCHEDULER_CHANNELS      { 1, 2, 3 }
+#define SCHEDULER_QUEUE_SIZE    8192
+#define SCHEDULER_LINK_DEPTH    1024
+
+/* Streaming transport backend, see streaming.c. One of "usb" (requires the
+ * USBD_BASE component), "uart", "udp" (requires IM_ENABLE_WIFI) or
+ * "loopback". */
+#if IM_ENABLE_WIFI
+#define STREAMING_TRANSPORT "udp"
+#elif defined(COMPONENT_USBD_BASE)
+#define STREAMING_TRANSPORT "usb"
+#else
+#define STREAMING_TRANSPORT "uart"
+#endif
+
 #endif
@@ -0,0 +1,173 @@
+/******************************************************************************
+* File Name:   crc.c
+*
+* Description: This file computes CRC-32 checksums, with the CRC block of the
+*              PSoC 6 when the HAL provides it and in software otherwise.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include "crc.h"
+#ifndef __linux__
+#include "cyhal.h"
+#endif
+
+#if !defined(__linux__) && defined(CYHAL_DRIVER_AVAILABLE_CRC) && CYHAL_DRIVER_AVAILABLE_CRC
+#define CRC_HARDWARE 1
+#else
+#define CRC_HARDWARE 0
+#endif
+
+
+/*******************************************************************************
+* Local Constants
+*******************************************************************************/
+#if CRC_HARDWARE
+static const crc_algorithm_t crc32_algorithm =
+{
+    .width         = 32,
+    .polynomial    = 0x04C11DB7,
+    .lfsrInitState = 0xFFFFFFFF,
+    .dataXor       = 0,
+    .dataReverse   = 1,
+    .remXor        = 0xFFFFFFFF,
+    .remReverse    = 1,
+};
+#endif
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+#if CRC_HARDWARE
+static cyhal_crc_t crc_obj;
+#else
+static uint32_t    crc_table[256];
+static uint32_t    crc_value;
+#endif
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: crc_init
+********************************************************************************
+* Summary:
+*  Reserves the CRC block, or builds the lookup table of the software
+*  implementation. Call this once before using any other function in this
+*  file.
+*
+*******************************************************************************/
+void crc_init(void)
+{
+#if CRC_HARDWARE
+    cyhal_crc_init(&crc_obj);
+#else
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+        {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+#endif
+}
+
+/*******************************************************************************
+* Function Name: crc_start
+********************************************************************************
+* Summary:
+*  Starts a new CRC computation.
+*
+*******************************************************************************/
+void crc_start(void)
+{
+#if CRC_HARDWARE
+    cyhal_crc_start(&crc_obj, &crc32_algorithm);
+#else
+    crc_value = 0xFFFFFFFFu;
+#endif
+}
+
+/*******************************************************************************
+* Function Name: crc_update
+********************************************************************************
+* Summary:
+*  Adds bytes to the current CRC computation.
+*
+* Parameters:
+*  data: pointer to the bytes
+*  size: number of bytes
+*
+*******************************************************************************/
+void crc_update(const void* data, size_t size)
+{
+#if CRC_HARDWARE
+    cyhal_crc_compute(&crc_obj, (const uint8_t*)data, size);
+#else
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t c = crc_value;
+    while (size--)
+    {
+        c = crc_table[(c ^ *p++) & 0xFF] ^ (c >> 8);
+    }
+    crc_value = c;
+#endif
+}
+
+/*******************************************************************************
+* Function Name: crc_finish
+********************************************************************************
+* Summary:
+*  Ends the current CRC computation.
+*
+* Return:
+*  The CRC of all bytes passed to crc_update() since crc_start().
+*
+*******************************************************************************/
+uint32_t crc_finish(void)
+{
+#if CRC_HARDWARE
+    uint32_t value = 0;
+    cyhal_crc_finish(&crc_obj, &value);
+    return value;
+#else
+    return crc_value ^ 0xFFFFFFFFu;
+#endif
+}
+
+/* [] END OF FILE */
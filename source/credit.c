@@ -0,0 +1,322 @@
+/******************************************************************************
+* File Name:   credit.c
+*
+* Description: This file contains the credit-based flow control: the credit the
+*              host has granted per channel and the bounded backlog of packets
+*              waiting for credit.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#include <string.h>
+#include "config.h"
+#include "credit.h"
+#include "packet_ring.h"
+
+/* CREDIT-BASED FLOW CONTROL
+ * =========================
+ * A channel is under flow control from the first credit command of the host
+ * until it is unsubscribed. The host grants credit in packets or in bytes on
+ * the link, and a packet is only sent while the channel holds enough credit
+ * for it. Packets without credit wait in the backlog of the channel, in
+ * order, and go out as soon as the host grants more. When the backlog is
+ * full, the oldest packet is dropped, so the host gets the most recent data
+ * and sees the gap in the sequence numbers.
+ *
+ * The backlogs take CREDIT_BACKLOG_SLOTS x CREDIT_BACKLOG_SIZE bytes of
+ * SRAM. A slot is taken by the first channel that needs it. */
+
+
+/*******************************************************************************
+* Local Type Declarations
+*******************************************************************************/
+/* A backlog and the credit of the channel using it */
+typedef struct
+{
+    uint8_t       channel;      /* Channel using the slot, 0 if free */
+    credit_unit_t unit;
+    uint32_t      credit;
+    uint32_t      dropped;
+    packet_ring_t backlog;
+    uint32_t      buffer[CREDIT_BACKLOG_SIZE / sizeof(uint32_t)];
+} credit_slot_t;
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+static credit_slot_t slots[CREDIT_BACKLOG_SLOTS];
+
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static credit_slot_t* credit_find(uint8_t channel);
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: credit_grant
+********************************************************************************
+* Summary:
+*  Grants credit to a channel and puts it under flow control if it is not
+*  already. Credit adds up; a grant in another unit replaces the credit left.
+*
+* Parameters:
+*  channel: the channel
+*  amount: the credit to add, possibly 0
+*  unit: packets or bytes
+*
+* Return:
+*  False if all backlogs are in use by other channels.
+*
+*******************************************************************************/
+bool credit_grant(uint8_t channel, uint32_t amount, credit_unit_t unit)
+{
+    credit_slot_t* slot = credit_find(channel);
+    if (slot == NULL)
+    {
+        slot = credit_find(0);
+        if (slot == NULL || channel == 0)
+        {
+            return false;
+        }
+        slot->channel = channel;
+        slot->unit = unit;
+        slot->credit = 0;
+        slot->dropped = 0;
+        packet_ring_init(&slot->backlog, slot->buffer, sizeof(slot->buffer));
+    }
+
+    if (slot->unit != unit)
+    {
+        slot->unit = unit;
+        slot->credit = 0;
+    }
+    slot->credit = amount > UINT32_MAX - slot->credit ? UINT32_MAX : slot->credit + amount;
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: credit_is_enabled
+********************************************************************************
+* Summary:
+*  Returns true if the channel is under flow control.
+*
+*******************************************************************************/
+bool credit_is_enabled(uint8_t channel)
+{
+    return channel != 0 && credit_find(channel) != NULL;
+}
+
+/*******************************************************************************
+* Function Name: credit_take
+********************************************************************************
+* Summary:
+*  Takes the credit for one packet, if the channel holds enough.
+*
+* Parameters:
+*  channel: the channel
+*  size: size of the packet on the link, including the framing
+*
+* Return:
+*  True if the packet may be sent.
+*
+*******************************************************************************/
+bool credit_take(uint8_t channel, size_t size)
+{
+    credit_slot_t* slot = credit_find(channel);
+    uint32_t cost = slot != NULL && slot->unit == CREDIT_BYTES ? (uint32_t)size : 1u;
+    if (slot == NULL || slot->credit < cost)
+    {
+        return false;
+    }
+    slot->credit -= cost;
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: credit_queue
+********************************************************************************
+* Summary:
+*  Stores a packet in the backlog of a channel, dropping the oldest packets
+*  until it fits. A packet larger than the whole backlog is dropped.
+*
+* Parameters:
+*  channel: the channel, which must be under flow control
+*  packet: size, sequence number and timestamp of the packet
+*  data: the payload
+*
+*******************************************************************************/
+void credit_queue(uint8_t channel, const packet_ring_entry_t* packet, const uint8_t* data)
+{
+    credit_slot_t* slot = credit_find(channel);
+    if (slot != NULL)
+    {
+        slot->dropped += packet_ring_put(&slot->backlog, packet, data);
+    }
+}
+
+/*******************************************************************************
+* Function Name: credit_peek
+********************************************************************************
+* Summary:
+*  Returns the oldest packet in the backlog of a channel.
+*
+* Parameters:
+*  channel: the channel
+*  packet: pointer to where size, sequence number and timestamp are stored
+*
+* Return:
+*  The payload, valid until the next call to credit_queue(), or NULL if
+*  the backlog is empty.
+*
+*******************************************************************************/
+const uint8_t* credit_peek(uint8_t channel, packet_ring_entry_t* packet)
+{
+    credit_slot_t* slot = credit_find(channel);
+    return slot != NULL ? packet_ring_peek(&slot->backlog, packet) : NULL;
+}
+
+/*******************************************************************************
+* Function Name: credit_pop
+********************************************************************************
+* Summary:
+*  Removes the oldest packet from the backlog of a channel.
+*
+*******************************************************************************/
+void credit_pop(uint8_t channel)
+{
+    credit_slot_t* slot = credit_find(channel);
+    if (slot != NULL)
+    {
+        packet_ring_pop(&slot->backlog);
+    }
+}
+
+/*******************************************************************************
+* Function Name: credit_disable
+********************************************************************************
+* Summary:
+*  Ends flow control of a channel. Its backlog is discarded.
+*
+*******************************************************************************/
+void credit_disable(uint8_t channel)
+{
+    credit_slot_t* slot = credit_find(channel);
+    if (slot != NULL && channel != 0)
+    {
+        slot->channel = 0;
+    }
+}
+
+/*******************************************************************************
+* Function Name: credit_reset
+********************************************************************************
+* Summary:
+*  Ends flow control of all channels.
+*
+*******************************************************************************/
+void credit_reset(void)
+{
+    for (size_t i = 0; i < CREDIT_BACKLOG_SLOTS; i++)
+    {
+        slots[i].channel = 0;
+    }
+}
+
+/*******************************************************************************
+* Function Name: credit_clear
+********************************************************************************
+* Summary:
+*  Empties all backlogs, e.g. when the sequence numbers restart. Channels
+*  stay under flow control with the credit they hold.
+*
+*******************************************************************************/
+void credit_clear(void)
+{
+    for (size_t i = 0; i < CREDIT_BACKLOG_SLOTS; i++)
+    {
+        packet_ring_clear(&slots[i].backlog);
+    }
+}
+
+/*******************************************************************************
+* Function Name: credit_get_stats
+********************************************************************************
+* Summary:
+*  Returns the flow control state of a channel; all zero if the channel is
+*  not under flow control.
+*
+* Parameters:
+*  channel: the channel
+*  stats: pointer to where the state will be stored
+*
+*******************************************************************************/
+void credit_get_stats(uint8_t channel, credit_stats_t* stats)
+{
+    const credit_slot_t* slot = channel != 0 ? credit_find(channel) : NULL;
+    memset(stats, 0, sizeof(*stats));
+    if (slot != NULL)
+    {
+        stats->credit = slot->credit;
+        stats->backlog = slot->backlog.count;
+        stats->dropped = slot->dropped;
+    }
+}
+
+/*******************************************************************************
+* Function Name: credit_find
+********************************************************************************
+* Summary:
+*  Returns the slot used by a channel, or with channel 0 a free slot; NULL
+*  if there is none.
+*
+*******************************************************************************/
+static credit_slot_t* credit_find(uint8_t channel)
+{
+    for (size_t i = 0; i < CREDIT_BACKLOG_SLOTS; i++)
+    {
+        if (slots[i].channel == channel)
+        {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,80 @@
+/******************************************************************************
+* File Name:   credit.h
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#ifndef SOURCE_CREDIT_H_
+#define SOURCE_CREDIT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "packet_ring.h"
+
+/*******************************************************************************
+* Type Definitions
+*******************************************************************************/
+/* What the host grants credit in */
+typedef enum
+{
+    CREDIT_PACKETS,     /* One unit per packet */
+    CREDIT_BYTES,       /* One unit per byte of the packet on the link */
+} credit_unit_t;
+
+/* Flow control state of one channel */
+typedef struct
+{
+    uint32_t credit;        /* Credit left, in the unit of the last grant */
+    uint32_t backlog;       /* Packets waiting for credit */
+    uint32_t dropped;       /* Packets dropped from a full backlog */
+} credit_stats_t;
+
+/*******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+bool credit_grant(uint8_t channel, uint32_t amount, credit_unit_t unit);
+bool credit_is_enabled(uint8_t channel);
+bool credit_take(uint8_t channel, size_t size);
+void credit_queue(uint8_t channel, const packet_ring_entry_t* packet, const uint8_t* data);
+const uint8_t* credit_peek(uint8_t channel, packet_ring_entry_t* packet);
+void credit_pop(uint8_t channel);
+void credit_disable(uint8_t channel);
+void credit_reset(void);
+void credit_clear(void);
+void credit_get_stats(uint8_t channel, credit_stats_t* stats);
+
+#endif /* SOURCE_CREDIT_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,239 @@
+/******************************************************************************
+* File Name:   history.c
+*
+* Description: This file contains the retransmission history: the most recent
+*              packets of each channel, kept so the host can have them resent.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#include <string.h>
+#include "config.h"
+#include "history.h"
+
+/* RETRANSMISSION HISTORY
+ * ======================
+ * Every packet of a channel in HISTORY_CHANNELS is copied into the history
+ * of the channel when it gets its sequence number, whether it is sent or
+ * dropped. The history is a ring of HISTORY_SIZE bytes, so it holds the
+ * most recent HISTORY_SIZE / (payload size padded to 4 bytes + 12) packets
+ * of the channel, the 12 bytes being its packet_ring_entry_t; older packets
+ * are overwritten. When the host finds a gap in the sequence
+ * numbers, it asks for the missing packets with the resend command. */
+
+
+/*******************************************************************************
+* Local Type Declarations
+*******************************************************************************/
+/* The history of one channel */
+typedef struct
+{
+    packet_ring_t   packets;
+    history_stats_t stats;
+    uint32_t        buffer[HISTORY_SIZE / sizeof(uint32_t)];
+} history_t;
+
+
+/*******************************************************************************
+* Local Constants
+*******************************************************************************/
+static const uint8_t HISTORY_CHANNEL_LIST[] = HISTORY_CHANNELS;
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+static history_t histories[sizeof(HISTORY_CHANNEL_LIST)];
+
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static history_t* history_find(uint8_t channel);
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: history_init
+********************************************************************************
+* Summary:
+*  Initializes the histories. Call this once before using any other function
+*  in this file.
+*
+*******************************************************************************/
+void history_init(void)
+{
+    for (size_t i = 0; i < sizeof(histories) / sizeof(histories[0]); i++)
+    {
+        packet_ring_init(&histories[i].packets, histories[i].buffer, sizeof(histories[i].buffer));
+    }
+}
+
+/*******************************************************************************
+* Function Name: history_is_kept
+********************************************************************************
+* Summary:
+*  Returns true if the channel has a history.
+*
+*******************************************************************************/
+bool history_is_kept(uint8_t channel)
+{
+    return history_find(channel) != NULL;
+}
+
+/*******************************************************************************
+* Function Name: history_put
+********************************************************************************
+* Summary:
+*  Adds a packet to the history of its channel, overwriting the oldest
+*  packets if needed. Does nothing if the channel has no history.
+*
+* Parameters:
+*  channel: the channel
+*  packet: size, sequence number and timestamp of the packet
+*  data: the payload
+*
+*******************************************************************************/
+void history_put(uint8_t channel, const packet_ring_entry_t* packet, const uint8_t* data)
+{
+    history_t* history = history_find(channel);
+    if (history != NULL)
+    {
+        packet_ring_put(&history->packets, packet, data);
+    }
+}
+
+/*******************************************************************************
+* Function Name: history_next
+********************************************************************************
+* Summary:
+*  Walks through the history of a channel, oldest packet first.
+*
+* Parameters:
+*  channel: the channel
+*  position: 0 for the oldest packet; updated for the next call
+*  packet: pointer to where size, sequence number and timestamp are stored
+*
+* Return:
+*  The payload, or NULL after the newest packet or if the channel has no
+*  history.
+*
+*******************************************************************************/
+const uint8_t* history_next(uint8_t channel, size_t* position, packet_ring_entry_t* packet)
+{
+    history_t* history = history_find(channel);
+    return history != NULL ? packet_ring_next(&history->packets, position, packet) : NULL;
+}
+
+/*******************************************************************************
+* Function Name: history_count
+********************************************************************************
+* Summary:
+*  Counts the packets of a resend request that were found in the history
+*  and those that were not.
+*
+*******************************************************************************/
+void history_count(uint8_t channel, uint32_t hits, uint32_t misses)
+{
+    history_t* history = history_find(channel);
+    if (history != NULL)
+    {
+        history->stats.hits += hits;
+        history->stats.misses += misses;
+    }
+}
+
+/*******************************************************************************
+* Function Name: history_clear
+********************************************************************************
+* Summary:
+*  Empties all histories, e.g. when the sequence numbers restart.
+*
+*******************************************************************************/
+void history_clear(void)
+{
+    for (size_t i = 0; i < sizeof(histories) / sizeof(histories[0]); i++)
+    {
+        packet_ring_clear(&histories[i].packets);
+    }
+}
+
+/*******************************************************************************
+* Function Name: history_get_stats
+********************************************************************************
+* Summary:
+*  Returns the resend accounting of a channel; all zero if the channel has
+*  no history.
+*
+* Parameters:
+*  channel: the channel
+*  stats: pointer to where the statistics will be stored
+*
+*******************************************************************************/
+void history_get_stats(uint8_t channel, history_stats_t* stats)
+{
+    const history_t* history = history_find(channel);
+    if (history != NULL)
+    {
+        *stats = history->stats;
+    }
+    else
+    {
+        memset(stats, 0, sizeof(*stats));
+    }
+}
+
+/*******************************************************************************
+* Function Name: history_find
+********************************************************************************
+* Summary:
+*  Returns the history of a channel, or NULL if it has none.
+*
+*******************************************************************************/
+static history_t* history_find(uint8_t channel)
+{
+    for (size_t i = 0; i < sizeof(HISTORY_CHANNEL_LIST); i++)
+    {
+        if (HISTORY_CHANNEL_LIST[i] == channel)
+        {
+            return &histories[i];
+        }
+    }
+    return NULL;
+}
+
+/* [] END OF FILE */
@@ -44,7 +44,10 @@
 #include "LSM6DSOSensor.h"
 #include "cyhal.h"
 #include "cybsp.h"
+#include "clock.h"
 #include "config.h"
+#include "protocol.h"
+#include "sensor.h"
 
 /*******************************************************************************
 * Macros
@@ -61,6 +64,9 @@
 #define IMU_TIMER_FREQUENCY 100000
 #define IMU_TIMER_PERIOD (IMU_TIMER_FREQUENCY/IMU_SCAN_RATE)
 #define IMU_TIMER_PRIORITY  3
+
+/* Most samples per packet the host may ask for */
+#define IMU_MAX_BATCH       50
 /*******************************************************************************
 * Global Variables
 *******************************************************************************/
@@ -77,6 +83,48 @@ cyhal_i2c_t i2c;
 cyhal_timer_t imu_timer;
 
 float imu_data[IMU_AXIS];
+
+/* Time in us of the last sample timer interrupt */
+volatile uint32_t imu_sample_time = 0;
+
+/* Gyroscope reading of the current sample in millidegrees per second, kept
+ * at full width since data.gyro only holds 16 bits, and whether it is set */
+static int32_t imu_gyroscope[3];
+static bool imu_gyro_read = false;
+
+/* Rates, shape and batch sizes advertised to the host */
+static const uint32_t imu_rates[] = { IMU_SCAN_RATE };
+static const uint16_t imu_batch_sizes[] = { 1, 5, 10, 25, IMU_MAX_BATCH };
+static uint8_t imu_batch_buffer[IMU_MAX_BATCH * IMU_AXIS * sizeof(float)];
+static sensor_t imu_sensor =
+{
+    .channel          = PROTOCOL_IMU_CHANNEL,
+    .type             = "accelerometer",
+    .datatype         = "f32",
+    .samples          = 1,
+    .features         = IMU_AXIS,
+    .rates            = imu_rates,
+    .rate_count       = sizeof(imu_rates) / sizeof(imu_rates[0]),
+    .batch_sizes      = imu_batch_sizes,
+    .batch_size_count = sizeof(imu_batch_sizes) / sizeof(imu_batch_sizes[0]),
+    .batch_buffer     = imu_batch_buffer,
+    .raw_datatype     = "s16",
+};
+/* The gyroscope on a channel of its own, in degrees per second */
+static uint8_t gyro_batch_buffer[IMU_MAX_BATCH * IMU_AXIS * sizeof(float)];
+static const sensor_t gyro_sensor =
+{
+    .channel          = PROTOCOL_GYRO_CHANNEL,
+    .type             = "gyroscope",
+    .datatype         = "f32",
+    .samples          = 1,
+    .features         = IMU_AXIS,
+    .rates            = imu_rates,
+    .rate_count       = sizeof(imu_rates) / sizeof(imu_rates[0]),
+    .batch_sizes      = imu_batch_sizes,
+    .batch_size_count = sizeof(imu_batch_sizes) / sizeof(imu_batch_sizes[0]),
+    .batch_buffer     = gyro_batch_buffer,
+};
 /*******************************************************************************
 * Local Function Prototypes
 *******************************************************************************/
@@ -140,6 +188,16 @@ cy_rslt_t imu_init(void)
         return result;
     }
 
+    /* One raw unit is the sensitivity in mg, scaled like imu_get_data() */
+    float sensitivity;
+    Get_X_Sensitivity(&mMPU, &sensitivity);
+    imu_sensor.raw_scale = sensitivity / (float)0x1000;
+
+    /* Make the accelerometer and, to v2 hosts, the gyroscope available to
+     * the host */
+    sensor_register(&imu_sensor);
+    sensor_register(&gyro_sensor);
+
     return CY_RSLT_SUCCESS;
 }
 
@@ -223,6 +281,7 @@ void imu_interrupt_handler(void *callback_arg, cyhal_timer_event_t event)
     (void) event;
 
     imu_flag = true;
+    imu_sample_time = clock_now_us();
 }
 
 /*******************************************************************************
@@ -241,17 +300,17 @@ void imu_get_data(float *imu_data)
     /* Read data from IMU sensor */
     cy_rslt_t result;
     int32_t accelerometer[3];
-    int32_t gyroscope[3];
     Get_X_Axes(&mMPU, accelerometer);
-    Get_G_Axes(&mMPU, gyroscope);
+    Get_G_Axes(&mMPU, imu_gyroscope);
 
     data.accel.x=accelerometer[0];
 	data.accel.y=accelerometer[1];
 	data.accel.z=accelerometer[2];
 
-	data.gyro.x=gyroscope[0];
-	data.gyro.y=gyroscope[1];
-	data.gyro.z=gyroscope[2];
+	data.gyro.x=imu_gyroscope[0];
+	data.gyro.y=imu_gyroscope[1];
+	data.gyro.z=imu_gyroscope[2];
+    imu_gyro_read = true;
 
     imu_data[0] = ((float)data.accel.x) / (float)0x1000;
     imu_data[1] = ((float)data.accel.y) / (float)0x1000;
@@ -263,3 +322,81 @@ void imu_get_data(float *imu_data)
         CY_ASSERT(0);
     }
 }
+
+/*******************************************************************************
+* Function Name: imu_get_raw_data
+********************************************************************************
+* Summary:
+*   Reads the unscaled accelerometer data from the IMU, as the host gets it
+*   when it subscribes with the s16 datatype. Multiplied by the raw_scale of
+*   the sensor, the values equal those of imu_get_data().
+*
+* Parameters:
+*     imu_data: Stores IMU accelerometer data
+*
+*******************************************************************************/
+void imu_get_raw_data(int16_t *imu_data)
+{
+    Get_X_AxesRaw(&mMPU, imu_data);
+    imu_gyro_read = false;
+}
+
+/*******************************************************************************
+* Function Name: imu_convert_raw_data
+********************************************************************************
+* Summary:
+*   Converts a sample read with imu_get_raw_data() to the values
+*   imu_get_data() returns, using the raw_scale of the sensor, without
+*   reading the IMU again.
+*
+* Parameters:
+*     raw_data: IMU accelerometer data from imu_get_raw_data()
+*     imu_data: Stores the converted IMU accelerometer data
+*
+*******************************************************************************/
+void imu_convert_raw_data(const int16_t *raw_data, float *imu_data)
+{
+    imu_data[0] = (float)raw_data[0] * imu_sensor.raw_scale;
+    imu_data[1] = (float)raw_data[1] * imu_sensor.raw_scale;
+    imu_data[2] = (float)raw_data[2] * imu_sensor.raw_scale;
+}
+
+/*******************************************************************************
+* Function Name: imu_get_gyro_data
+********************************************************************************
+* Summary:
+*   Returns the gyroscope data of the current sample in degrees per second,
+*   as sent on the gyroscope channel. imu_get_data() already read it along
+*   with the accelerometer; only after imu_get_raw_data() is it read from
+*   the IMU here.
+*
+* Parameters:
+*     gyro_data: Stores IMU gyroscope data
+*
+*******************************************************************************/
+void imu_get_gyro_data(float *gyro_data)
+{
+    if (!imu_gyro_read)
+    {
+        Get_G_Axes(&mMPU, imu_gyroscope);
+        imu_gyro_read = true;
+    }
+
+    /* The driver reports millidegrees per second */
+    gyro_data[0] = (float)imu_gyroscope[0] / 1000.0f;
+    gyro_data[1] = (float)imu_gyroscope[1] / 1000.0f;
+    gyro_data[2] = (float)imu_gyroscope[2] / 1000.0f;
+}
+
+/*******************************************************************************
+* Function Name: imu_get_sample_time
+********************************************************************************
+* Summary:
+*   Returns the time in us when the sample timer last fired, see
+*   clock_now_us().
+*
+*******************************************************************************/
+uint32_t imu_get_sample_time(void)
+{
+    return imu_sample_time;
+}
@@ -60,6 +60,10 @@ extern volatile bool imu_flag;
 *******************************************************************************/
 cy_rslt_t imu_init(void);
 void imu_get_data(float *imu_data);
+void imu_get_raw_data(int16_t *imu_data);
+void imu_convert_raw_data(const int16_t *raw_data, float *imu_data);
+void imu_get_gyro_data(float *gyro_data);
+uint32_t imu_get_sample_time(void);
 
 
 #endif /* IMU_H */
@@ -43,12 +43,31 @@
 #include "cybsp.h"
 #include "cy_retarget_io.h"
 #include "stdlib.h"
+#include "string.h"
 #include "config.h"
 #include "audio.h"
+#include "backpressure.h"
 #ifdef IM_ENABLE_IMU
   #include "imu.h"
+  #include "mux.h"
 #endif
 #include "protocol.h"
+#include "usb_audio.h"
+#if IM_ENABLE_WIFI
+  #include "FreeRTOS.h"
+  #include "task.h"
+#endif
+
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#if IM_ENABLE_WIFI
+#define MAIN_TASK_STACK_SIZE (4096u)
+/* Stack size in words of the task running the main loop */
+#define MAIN_TASK_PRIORITY (configMAX_PRIORITIES - 3)
+/* Below the Wi-Fi driver and lwIP threads */
+#endif
 
 
 /*******************************************************************************
@@ -58,13 +77,18 @@ volatile bool pdm_pcm_flag;
 volatile bool imu_flag;
 
 
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static void main_loop(void* arg);
+
+
 /*******************************************************************************
 * Function Name: main
 ********************************************************************************
 * Summary:
-*  This is the main function. It sets up either the PDM or IMU based on the
-*  config.h file. main continuously checks flags, signaling that data is ready
-*  to be streamed over UART or USB and initiates the transfer.
+*  This is the main function. It initializes the board and runs main_loop(),
+*  in a FreeRTOS task when the Wi-Fi stack is used.
 *
 *******************************************************************************/
 int main(void)
@@ -81,21 +105,59 @@ int main(void)
     /* Enable global interrupts */
     __enable_irq();
 
+#if IM_ENABLE_WIFI
+    /* The Wi-Fi connection manager and lwIP need the scheduler running */
+    xTaskCreate(main_loop, "main", MAIN_TASK_STACK_SIZE, NULL, MAIN_TASK_PRIORITY, NULL);
+    vTaskStartScheduler();
+
+    /* Should never get here */
+    CY_ASSERT(0);
+#else
+    main_loop(NULL);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: main_loop
+********************************************************************************
+* Summary:
+*  Sets up either the PDM or IMU based on the config.h file, then continuously
+*  checks flags, signaling that data is ready to be streamed, and initiates
+*  the transfer.
+*
+* Parameters:
+*  arg: not used
+*
+*******************************************************************************/
+static void main_loop(void* arg)
+{
+    cy_rslt_t result;
+
+    (void)arg;
+
+    /* Select the streaming transport (see config.h) */
+    streaming_select(STREAMING_TRANSPORT);
+
 #ifdef COMPONENT_USBD_BASE
-    /* Initialize retarget-io to use the debug UART port */
-    cy_retarget_io_init(CYBSP_DEBUG_UART_TX, CYBSP_DEBUG_UART_RX, CY_RETARGET_IO_BAUDRATE);
+    /* Initialize retarget-io to use the debug UART port, unless the debug
+     * UART is used for streaming */
+    if (strcmp(streaming_get_transport()->name, "uart") != 0)
+    {
+        cy_retarget_io_init(CYBSP_DEBUG_UART_TX, CYBSP_DEBUG_UART_RX, CY_RETARGET_IO_BAUDRATE);
 
-    printf("\x1b[2J\x1b[;H");
+        printf("\x1b[2J\x1b[;H");
 
-    printf("*********** "
-           "PSoC 6 MCU: Imagimob Streaming Protocol"
-           "*********** \r\n\n");
+        printf("*********** "
+               "PSoC 6 MCU: Imagimob Streaming Protocol"
+               "*********** \r\n\n");
+    }
 #endif
 
     /* Initialize the User LED */
     cyhal_gpio_init(CYBSP_USER_LED, CYHAL_GPIO_DIR_OUTPUT, CYHAL_GPIO_DRIVE_STRONG, CYBSP_LED_STATE_OFF);
 
-    /* Initialize the streaming interface */
+    /* Initialize the streaming interface. This does not wait for a host;
+     * USB enumerates in the background while the sensors start up. */
     streaming_init();
 
     /* Initialize protocol (start timer) */
@@ -115,6 +177,9 @@ int main(void)
 
     /* Start the imu and timer */
     result = imu_init();
+
+    /* Offer audio and IMU data combined in one channel */
+    mux_init();
 #endif
 
     /* Initialization failed */
@@ -134,10 +199,38 @@ int main(void)
         if (true == imu_flag)
         {
             imu_flag = false;
-            /* Store IMU data */
-            imu_get_data(imu_raw_data);
-            /* Transmit data */
-            protocol_send(PROTOCOL_IMU_CHANNEL, transmit_imu, sizeof(transmit_imu));
+            int16_t imu_counts[IMU_AXIS];
+            bool raw = protocol_is_raw(PROTOCOL_IMU_CHANNEL);
+            if (raw)
+            {
+                /* Transmit the unscaled readings, at half the size */
+                imu_get_raw_data(imu_counts);
+                protocol_send(PROTOCOL_IMU_CHANNEL, (uint8_t*)imu_counts, sizeof(imu_counts), imu_get_sample_time());
+            }
+            else
+            {
+                /* Store IMU data */
+                imu_get_data(imu_raw_data);
+                /* Transmit data */
+                protocol_send(PROTOCOL_IMU_CHANNEL, transmit_imu, sizeof(transmit_imu), imu_get_sample_time());
+            }
+            if (protocol_is_subscribed(PROTOCOL_MUX_CHANNEL))
+            {
+                if (raw)
+                {
+                    /* The combined channel takes f32; convert this sample
+                     * rather than reading another one from the IMU */
+                    imu_convert_raw_data(imu_counts, imu_raw_data);
+                }
+                /* Keep the sample, in f32, for the next combined frame */
+                mux_add_imu(imu_raw_data, imu_get_sample_time());
+            }
+            if (protocol_is_subscribed(PROTOCOL_GYRO_CHANNEL))
+            {
+                float gyro_data[IMU_AXIS];
+                imu_get_gyro_data(gyro_data);
+                protocol_send(PROTOCOL_GYRO_CHANNEL, (uint8_t*)gyro_data, sizeof(gyro_data), imu_get_sample_time());
+            }
         }
 #endif
         if (true == pdm_pcm_flag)
@@ -145,8 +238,21 @@ int main(void)
             pdm_pcm_flag = false;
             /* Store PDM data */
             pdm_preprocessing_feed(pdm_raw_data);
+            /* Account for frames lost in the PDM interrupt */
+            backpressure_set_overruns(PROTOCOL_AUDIO_CHANNEL, pdm_get_overruns());
+#if IM_ENABLE_USB_AUDIO
+            /* Feed the USB Audio Class microphone */
+            usb_audio_write(pdm_raw_data, FRAME_SIZE);
+#endif
             /* Transmit data */
-            protocol_send(PROTOCOL_AUDIO_CHANNEL, transmit_pdm, sizeof(transmit_pdm));
+            protocol_send(PROTOCOL_AUDIO_CHANNEL, transmit_pdm, sizeof(transmit_pdm), pdm_get_frame_time());
+#if IM_ENABLE_IMU
+            /* The same frame with the IMU samples captured during it */
+            if (protocol_is_subscribed(PROTOCOL_MUX_CHANNEL))
+            {
+                mux_send_frame(pdm_raw_data, pdm_get_frame_time());
+            }
+#endif
         }
     }
 }
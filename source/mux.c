@@ -0,0 +1,208 @@
+/******************************************************************************
+* File Name:   mux.c
+*
+* Description: This file contains the combined audio and IMU channel: one packet
+*              per audio frame with the IMU samples captured during the frame.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#include <string.h>
+#include "audio.h"
+#include "config.h"
+#include "imu.h"
+#include "mux.h"
+#include "protocol.h"
+#include "sensor.h"
+
+/* COMBINED AUDIO AND IMU CHANNEL
+ * ==============================
+ * A host that records audio and IMU data on channels 1 and 2 has to line
+ * them up by their timestamps. On the combined channel, the device does
+ * that: each packet holds one audio frame, as completed at the ping-pong
+ * swap in pdm_pcm_event_handler(), and every IMU sample captured within that
+ * frame, each with the index of the audio sample taken at the same time.
+ *
+ * The main loop passes IMU samples to mux_add_imu() as they arrive, and the
+ * audio frame to mux_send_frame(). IMU samples captured after the end of the
+ * frame are kept for the next one; those from before its start, e.g. during
+ * a lost frame, are dropped.
+ *
+ * Packet layout, all little endian:
+ *   u16 audio sample count
+ *   u16 IMU sample count n
+ *   s16 audio samples[audio sample count]
+ *   n x { u16 audio sample index, u16 0, f32 x, f32 y, f32 z } */
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define MUX_HEADER_SIZE         (4u)
+/* Audio and IMU sample counts */
+#define MUX_IMU_RECORD_SIZE     (4u + IMU_AXIS * sizeof(float))
+/* One IMU sample with its audio sample index */
+#define MUX_MAX_PACKET_SIZE     (MUX_HEADER_SIZE + FRAME_SIZE * sizeof(int16_t) + \
+                                 MUX_MAX_IMU_SAMPLES * MUX_IMU_RECORD_SIZE)
+#define MUX_FRAME_TIME_US       ((uint32_t)((uint64_t)FRAME_SIZE * 1000000u / PDM_SAMPLE_RATE))
+/* Duration of one audio frame */
+
+
+/*******************************************************************************
+* Local Type Declarations
+*******************************************************************************/
+/* An IMU sample waiting for its audio frame */
+typedef struct
+{
+    uint32_t timestamp;
+    float    sample[IMU_AXIS];
+} mux_imu_sample_t;
+
+
+/*******************************************************************************
+* Local Constants
+*******************************************************************************/
+static const uint32_t mux_rates[] = { PDM_SAMPLE_RATE };
+static const sensor_t mux_sensor =
+{
+    .channel          = PROTOCOL_MUX_CHANNEL,
+    .type             = "microphone+accelerometer",
+    .datatype         = "mux",
+    .samples          = 1,
+    .features         = FRAME_SIZE,
+    .rates            = mux_rates,
+    .rate_count       = sizeof(mux_rates) / sizeof(mux_rates[0]),
+};
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+static mux_imu_sample_t mux_imu_samples[MUX_MAX_IMU_SAMPLES];
+static size_t mux_imu_count = 0;
+static uint32_t mux_packet[(MUX_MAX_PACKET_SIZE + 3u) / 4u];
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: mux_init
+********************************************************************************
+* Summary:
+*  Makes the combined channel available to the host. Call this after the
+*  microphone and the IMU have been started.
+*
+*******************************************************************************/
+void mux_init(void)
+{
+    mux_imu_count = 0;
+    sensor_register(&mux_sensor);
+}
+
+/*******************************************************************************
+* Function Name: mux_add_imu
+********************************************************************************
+* Summary:
+*  Keeps an IMU sample for the audio frame it was captured in. If more than
+*  MUX_MAX_IMU_SAMPLES are waiting, the oldest is dropped.
+*
+* Parameters:
+*  sample: IMU_AXIS values, as from imu_get_data()
+*  timestamp: capture time of the sample in us, see clock_now_us()
+*
+*******************************************************************************/
+void mux_add_imu(const float* sample, uint32_t timestamp)
+{
+    if (mux_imu_count == MUX_MAX_IMU_SAMPLES)
+    {
+        memmove(&mux_imu_samples[0], &mux_imu_samples[1], sizeof(mux_imu_samples) - sizeof(mux_imu_samples[0]));
+        mux_imu_count--;
+    }
+    mux_imu_samples[mux_imu_count].timestamp = timestamp;
+    memcpy(mux_imu_samples[mux_imu_count].sample, sample, sizeof(mux_imu_samples[0].sample));
+    mux_imu_count++;
+}
+
+/*******************************************************************************
+* Function Name: mux_send_frame
+********************************************************************************
+* Summary:
+*  Sends an audio frame with the IMU samples captured during it on the
+*  combined channel, as one packet.
+*
+* Parameters:
+*  pcm: FRAME_SIZE audio samples
+*  frame_time: time in us when the frame was completed, see
+*              pdm_get_frame_time()
+*
+*******************************************************************************/
+void mux_send_frame(const int16_t* pcm, uint32_t frame_time)
+{
+    uint8_t* packet = (uint8_t*)mux_packet;
+    uint8_t* record = packet + MUX_HEADER_SIZE + FRAME_SIZE * sizeof(int16_t);
+    uint16_t header[2] = { FRAME_SIZE, 0 };
+    size_t kept = 0;
+
+    memcpy(packet + MUX_HEADER_SIZE, pcm, FRAME_SIZE * sizeof(int16_t));
+
+    for (size_t i = 0; i < mux_imu_count; i++)
+    {
+        const mux_imu_sample_t* imu = &mux_imu_samples[i];
+        uint32_t age = frame_time - imu->timestamp;
+
+        if ((int32_t)age < 0)
+        {
+            /* Captured after the end of the frame */
+            mux_imu_samples[kept++] = *imu;
+        }
+        else if (age < MUX_FRAME_TIME_US)
+        {
+            /* Index of the last audio sample captured before the IMU sample */
+            uint32_t samples_after = (uint32_t)((uint64_t)age * PDM_SAMPLE_RATE / 1000000u);
+            uint16_t index[2] = { (uint16_t)(FRAME_SIZE - 1u - samples_after), 0 };
+            memcpy(record, index, sizeof(index));
+            memcpy(record + sizeof(index), imu->sample, sizeof(imu->sample));
+            record += MUX_IMU_RECORD_SIZE;
+            header[1]++;
+        }
+    }
+    mux_imu_count = kept;
+
+    memcpy(packet, header, sizeof(header));
+    protocol_send(PROTOCOL_MUX_CHANNEL, packet, (size_t)(record - packet), frame_time);
+}
+
+/* [] END OF FILE */
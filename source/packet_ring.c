@@ -0,0 +1,247 @@
+/******************************************************************************
+* File Name:   packet_ring.c
+*
+* Description: This file contains a ring buffer of whole packets, used for the
+*              backlogs of flow control and the retransmission history.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#include <string.h>
+#include "packet_ring.h"
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define PACKET_RING_ENTRY_SIZE(size)    (sizeof(packet_ring_entry_t) + (((size) + 3u) & ~(size_t)3u))
+/* Bytes a packet with a payload of size bytes takes in the ring */
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: packet_ring_init
+********************************************************************************
+* Summary:
+*  Initializes an empty ring in the given buffer.
+*
+* Parameters:
+*  ring: the ring
+*  buffer: storage for the packets
+*  size: size of the buffer in bytes
+*
+*******************************************************************************/
+void packet_ring_init(packet_ring_t* ring, uint32_t* buffer, size_t size)
+{
+    ring->buffer = (uint8_t*)buffer;
+    ring->size = size;
+    packet_ring_clear(ring);
+}
+
+/*******************************************************************************
+* Function Name: packet_ring_clear
+********************************************************************************
+* Summary:
+*  Removes all packets from a ring.
+*
+*******************************************************************************/
+void packet_ring_clear(packet_ring_t* ring)
+{
+    ring->head = 0;
+    ring->tail = 0;
+    ring->end = 0;
+    ring->wrapped = false;
+    ring->count = 0;
+}
+
+/*******************************************************************************
+* Function Name: packet_ring_put
+********************************************************************************
+* Summary:
+*  Stores a packet in a ring, dropping the oldest packets until it fits. A
+*  packet larger than the whole ring is dropped.
+*
+* Parameters:
+*  ring: the ring
+*  entry: size, sequence number and timestamp of the packet
+*  data: the payload
+*
+* Return:
+*  The number of packets dropped, including the new one if it is too large.
+*
+*******************************************************************************/
+uint32_t packet_ring_put(packet_ring_t* ring, const packet_ring_entry_t* entry, const uint8_t* data)
+{
+    size_t entry_size = PACKET_RING_ENTRY_SIZE(entry->size);
+    uint32_t dropped = 0;
+
+    if (entry_size > ring->size)
+    {
+        return 1;
+    }
+
+    while (!packet_ring_has_room(ring, entry->size))
+    {
+        packet_ring_pop(ring);
+        dropped++;
+    }
+
+    /* Start over at the beginning if the packet does not fit at the end */
+    if (!ring->wrapped && ring->size - ring->head < entry_size)
+    {
+        ring->end = ring->head;
+        ring->head = 0;
+        ring->wrapped = true;
+    }
+
+    uint8_t* p = ring->buffer + ring->head;
+    memcpy(p, entry, sizeof(*entry));
+    memcpy(p + sizeof(*entry), data, entry->size);
+    ring->head += entry_size;
+    ring->count++;
+    return dropped;
+}
+
+/*******************************************************************************
+* Function Name: packet_ring_peek
+********************************************************************************
+* Summary:
+*  Returns the oldest packet in a ring.
+*
+* Parameters:
+*  ring: the ring
+*  entry: pointer to where size, sequence number and timestamp are stored
+*
+* Return:
+*  The payload, valid until the next call to packet_ring_put(), or NULL if
+*  the ring is empty.
+*
+*******************************************************************************/
+const uint8_t* packet_ring_peek(const packet_ring_t* ring, packet_ring_entry_t* entry)
+{
+    size_t position = 0;
+    return packet_ring_next(ring, &position, entry);
+}
+
+/*******************************************************************************
+* Function Name: packet_ring_pop
+********************************************************************************
+* Summary:
+*  Removes the oldest packet from a ring.
+*
+*******************************************************************************/
+void packet_ring_pop(packet_ring_t* ring)
+{
+    packet_ring_entry_t entry;
+    if (packet_ring_peek(ring, &entry) == NULL)
+    {
+        return;
+    }
+
+    ring->tail += PACKET_RING_ENTRY_SIZE(entry.size);
+    if (--ring->count == 0)
+    {
+        packet_ring_clear(ring);
+    }
+    else if (ring->wrapped && ring->tail == ring->end)
+    {
+        ring->tail = 0;
+        ring->wrapped = false;
+    }
+}
+
+/*******************************************************************************
+* Function Name: packet_ring_next
+********************************************************************************
+* Summary:
+*  Walks through the packets in a ring, oldest first.
+*
+* Parameters:
+*  ring: the ring
+*  position: 0 for the oldest packet; updated for the next call
+*  entry: pointer to where size, sequence number and timestamp are stored
+*
+* Return:
+*  The payload, valid until the next call to packet_ring_put(), or NULL
+*  after the newest packet.
+*
+*******************************************************************************/
+const uint8_t* packet_ring_next(const packet_ring_t* ring, size_t* position, packet_ring_entry_t* entry)
+{
+    /* position counts the bytes from the tail, ignoring the unused space
+     * before a wrap */
+    size_t used = ring->wrapped ? ring->end - ring->tail + ring->head : ring->head - ring->tail;
+    if (ring->count == 0 || *position >= used)
+    {
+        return NULL;
+    }
+
+    size_t offset = ring->tail + *position;
+    if (ring->wrapped && offset >= ring->end)
+    {
+        offset -= ring->end;
+    }
+
+    const uint8_t* p = ring->buffer + offset;
+    memcpy(entry, p, sizeof(*entry));
+    *position += PACKET_RING_ENTRY_SIZE(entry->size);
+    return p + sizeof(*entry);
+}
+
+/*******************************************************************************
+* Function Name: packet_ring_has_room
+********************************************************************************
+* Summary:
+*  Returns true if a packet with a payload of size bytes fits in a ring
+*  without dropping packets.
+*
+*******************************************************************************/
+bool packet_ring_has_room(const packet_ring_t* ring, size_t size)
+{
+    size_t entry_size = PACKET_RING_ENTRY_SIZE(size);
+    if (ring->count == 0)
+    {
+        return true;
+    }
+    if (ring->wrapped)
+    {
+        return ring->tail - ring->head >= entry_size;
+    }
+    return ring->size - ring->head >= entry_size || ring->tail >= entry_size;
+}
+
+/* [] END OF FILE */
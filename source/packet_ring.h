@@ -0,0 +1,83 @@
+/******************************************************************************
+* File Name:   packet_ring.h
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#ifndef SOURCE_PACKET_RING_H_
+#define SOURCE_PACKET_RING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+* Type Definitions
+*******************************************************************************/
+/* A packet stored in a ring */
+typedef struct
+{
+    uint16_t size;          /* Payload size in bytes */
+    uint16_t sequence;      /* Sequence number of the packet */
+    uint32_t timestamp;     /* Capture time of the last sample in us */
+} packet_ring_entry_t;
+
+/* A ring of whole packets in a buffer. Each packet is stored as a
+ * packet_ring_entry_t followed by the payload, padded to a multiple of 4
+ * bytes, and is never split at the end of the buffer. */
+typedef struct
+{
+    uint8_t* buffer;        /* 4-byte aligned */
+    size_t   size;
+    size_t   head;          /* Where the next packet is stored */
+    size_t   tail;          /* The oldest packet */
+    size_t   end;           /* End of the packets stored before head wrapped */
+    bool     wrapped;       /* head is before tail */
+    uint32_t count;         /* Packets in the ring */
+} packet_ring_t;
+
+/*******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+void packet_ring_init(packet_ring_t* ring, uint32_t* buffer, size_t size);
+void packet_ring_clear(packet_ring_t* ring);
+bool packet_ring_has_room(const packet_ring_t* ring, size_t size);
+uint32_t packet_ring_put(packet_ring_t* ring, const packet_ring_entry_t* entry, const uint8_t* data);
+const uint8_t* packet_ring_peek(const packet_ring_t* ring, packet_ring_entry_t* entry);
+void packet_ring_pop(packet_ring_t* ring);
+const uint8_t* packet_ring_next(const packet_ring_t* ring, size_t* position, packet_ring_entry_t* entry);
+
+#endif /* SOURCE_PACKET_RING_H_ */
+
+/* [] END OF FILE */
@@ -39,59 +39,233 @@
 *******************************************************************************/
 
 #include <stdio.h>
+#include <string.h>
+#include "backpressure.h"
+#include "bench.h"
 #include "clock.h"
+#include "cobs.h"
+#include "command.h"
 #include "config.h"
+#include "crc.h"
+#include "credit.h"
+#include "history.h"
 #include "protocol.h"
+#include "scheduler.h"
+#include "sensor.h"
+#include "tlv.h"
+#include "usb_audio.h"
 
 
 /******************************************************************************
  * Macros
  *****************************************************************************/
-#define RECEIVE_BUFFER_SIZE 32
+#define RECEIVE_BUFFER_SIZE 64
 #define HEARTBEAT_TIMEOUT_MS 5000
+#define DEVICE_NAME "PSoC6"
+#define CONFIG_MESSAGE_SIZE 2048
+#define ENDPOINT_FIELD_SIZE 40
+#define RATES_FIELD_SIZE 64
+#define DATATYPES_FIELD_SIZE 96
+#define STATS_MESSAGE_SIZE 3072
+#define MAX_TEXT_SIZE (CONFIG_MESSAGE_SIZE > STATS_MESSAGE_SIZE ? CONFIG_MESSAGE_SIZE : STATS_MESSAGE_SIZE)
+/* Largest text response, the config? or stats? response */
+#define MAX_FRAME_SIZE (PROTOCOL_V2_HEADER_SIZE + PROTOCOL_MAX_PAYLOAD_SIZE)
+#define MIN_FRAGMENT_SIZE 64
+#define CONTROL_MESSAGE_SIZE 1024
+#define CHANNEL_COUNTERS 14
+
+
+/*******************************************************************************
+* Local Type Declarations
+*******************************************************************************/
+/* Packet framing, selected with the framing command */
+typedef enum
+{
+    FRAMING_V1,     /* B<channel><payload>\r\n */
+    FRAMING_V2,     /* Binary header with length, sequence, time and CRC */
+    FRAMING_COBS,   /* COBS encoded v2 frame, delimited by a zero byte */
+    FRAMING_ALIGN4, /* v1 with the header and frame padded to 4 bytes */
+    FRAMING_ALIGN8  /* v1 with the header and frame padded to 8 bytes */
+} framing_t;
+
+/* Outcome of a request, sent as text in a version 1 session and as the
+ * status item of a control message in version 2; the values are the status
+ * codes of PROTOCOL.md */
+typedef enum
+{
+    STATUS_OK,
+    STATUS_UNRECOGNIZED_COMMAND,
+    STATUS_INVALID_ARGUMENT,
+    STATUS_TOO_LONG_COMMAND,
+    STATUS_UNKNOWN_CHANNEL,
+    STATUS_UNSUPPORTED_RATE,
+    STATUS_UNSUPPORTED_BATCH_SIZE,
+    STATUS_UNSUPPORTED_DATATYPE,
+    STATUS_NO_BACKLOG,
+    STATUS_NO_HISTORY,
+    STATUS_UNSUPPORTED_FRAMING,
+    STATUS_UNSUPPORTED_VERSION,
+} protocol_status_t;
+
+/* Subscription of a channel */
+typedef struct
+{
+    bool     active;
+    uint32_t rate;                  /* Samples per second */
+    uint16_t samples_per_packet;
+    const char* datatype;           /* datatype or raw_datatype of the sensor */
+    size_t   fill;                  /* Bytes collected in the batch buffer */
+} protocol_subscription_t;
 
 
 /*******************************************************************************
 * Local Constants
 *******************************************************************************/
-static const char* TOO_LONG_COMMAND_MESSAGE = "ERROR:Too long command\r\n\0";
-static const char* CONFIG_MESSAGE =
+/* The config message is CONFIG_HEADER, CONFIG_SENSOR_FORMAT for each
+ * sensor and CONFIG_FOOTER, see protocol_get_config() */
+static const char* CONFIG_HEADER =
         "{\r\n"
-        "    \"device_name\": \"PSoC6\",\r\n"
+        "    \"device_name\": \"" DEVICE_NAME "\",\r\n"
         "    \"protocol_version\": 1,\r\n"
+        "    \"protocol_versions\": [ 1, 2 ],\r\n"
         "    \"heartbeat_timeout\": 5,\r\n"
-        "    \"sensors\": [\r\n"
-        "        {\r\n"
-        "            \"channel\": 1,\r\n"
-        "            \"type\": \"microphone\",\r\n"
-        "            \"datatype\": \"s16\",\r\n"
-        "            \"shape\": [ 1024, 1 ],\r\n"
-        "            \"rates\": [ 16000 ]\r\n"
-#if IM_ENABLE_IMU
-        "        },\r\n"
+        "    \"framings\": [ \"v1\", \"v2\", \"cobs\", \"align4\", \"align8\" ],\r\n"
+        "    \"sensors\": [\r\n";
+static const char* CONFIG_SENSOR_FORMAT =
+        "%s"
         "        {\r\n"
-        "            \"channel\": 2,\r\n"
-        "            \"type\": \"accelerometer\",\r\n"
-        "            \"datatype\": \"f32\",\r\n"
-        "            \"shape\": [ 1, 3 ],\r\n"
-        "            \"rates\": [ 50 ]\r\n"
-#endif
-        "        }\r\n"
+        "            \"channel\": %u,\r\n"
+        "            \"type\": \"%s\",\r\n"
+        "            \"datatype\": \"%s\",\r\n"
+        "            \"shape\": [ %u, %u ],\r\n"
+        "            \"rates\": [ %s ],\r\n"
+        "            \"batch_sizes\": [ %s ]%s%s\r\n"
+        "        }";
+static const char* CONFIG_FOOTER =
+        "\r\n"
         "    ]\r\n"
-        "}\r\n\0";
-static const char* OK_MESSAGE = "OK\r\n\0";
-static const char* UNRECOGNIZED_COMMAND_MESSAGE = "ERROR:Unrecognized command\r\n\0";
+        "}\r\n";
+/* Response of each status in a version 1 session, in protocol_status_t order */
+static const char* const STATUS_MESSAGES[] =
+{
+    "OK\r\n",
+    "ERROR:Unrecognized command\r\n",
+    "ERROR:Invalid argument\r\n",
+    "ERROR:Too long command\r\n",
+    "ERROR:Unknown channel\r\n",
+    "ERROR:Unsupported rate\r\n",
+    "ERROR:Unsupported batch size\r\n",
+    "ERROR:Unsupported datatype\r\n",
+    "ERROR:No backlog available\r\n",
+    "ERROR:No history\r\n",
+    "ERROR:Unsupported framing\r\n",
+    "ERROR:Unsupported protocol version\r\n",
+};
 static const uint8_t CRLF[2] = { '\r', '\n' };
+/* Names of the framings, in framing_t order */
+static const char* const FRAMING_NAMES[] = { "v1", "v2", "cobs", "align4", "align8" };
+/* Padding bytes of the aligned framings */
+static const uint8_t PADDING[8] = { 0 };
 
 
 /*******************************************************************************
 * Local Variables
 *******************************************************************************/
+static char config_message[CONFIG_MESSAGE_SIZE];
+/* Registry generation and framing config_message was built for; see
+ * protocol_get_config() */
+static uint32_t config_generation = UINT32_MAX;
+static framing_t config_framing = FRAMING_V1;
 static char receive_buffer[RECEIVE_BUFFER_SIZE];
 static char *receive_p = receive_buffer;
-static volatile bool subscribe_audio = false;
-static volatile bool subscribe_imu = false;
+static protocol_subscription_t subscriptions[PROTOCOL_MAX_CHANNEL + 1];
 static uint32_t last_receive_time = 0;
+static framing_t framing = FRAMING_V1;
+/* Largest payload of a frame of a scheduled channel, 0 for whole packets */
+static size_t fragment_size = 0;
+/* Sequence number of the next packet of each channel */
+static uint16_t sequence[PROTOCOL_MAX_CHANNEL + 1];
+/* Protocol version of the session, see the protocol command */
+static uint8_t session_version = 1;
+/* Sequence number of the binary request being executed, or -1 */
+static int32_t request_number = -1;
+/* Set once the binary request being executed has been answered */
+static bool request_answered;
+/* Control message of a version 2 session being built */
+static uint8_t control_message[CONTROL_MESSAGE_SIZE];
+/* Encoded frame or text response with COBS framing */
+static uint8_t frame_buffer[COBS_MAX_ENCODED_SIZE(MAX_TEXT_SIZE > MAX_FRAME_SIZE ? MAX_TEXT_SIZE : MAX_FRAME_SIZE)];
+
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static void protocol_execute(char* command);
+static size_t protocol_receive_frame(const uint8_t* data, size_t size);
+static void protocol_execute_request(uint16_t number, const uint8_t* payload, size_t size);
+static void protocol_send_result(command_result_t result);
+static void protocol_send_status(protocol_status_t status);
+static void protocol_send_notification(uint8_t event);
+static void protocol_begin_control(tlv_writer_t* writer);
+static void protocol_send_control(const tlv_writer_t* writer);
+static void protocol_send_config(void);
+static bool protocol_find_framing(const char* name, framing_t* found);
+static const char* protocol_get_config(framing_t selected);
+static void protocol_format_list(char* field, size_t field_size, const uint32_t* values, const uint16_t* values16, size_t count);
+static void protocol_format_datatypes(char* field, const sensor_t* sensor);
+static void protocol_send_packet(uint8_t channel, const uint8_t* data, size_t size, uint32_t timestamp);
+static void protocol_send_numbered(uint8_t channel, uint16_t number, const uint8_t* data, size_t size, uint32_t timestamp);
+static void protocol_send_backlog(uint8_t channel);
+static bool protocol_take_credit(uint8_t channel, size_t size);
+static bool protocol_is_scheduled(uint8_t channel);
+static void protocol_send_scheduled(void);
+static void protocol_send_frame_numbered(uint8_t channel, uint16_t number, uint8_t flags, uint8_t index, const uint8_t* data, size_t size, uint32_t timestamp);
+static void protocol_unsubscribe_all(void);
+static bool protocol_is_streaming(void);
+static uint8_t protocol_get_max_channel(framing_t selected);
+static bool protocol_is_offered(const sensor_t* sensor, framing_t selected);
+static const sensor_t* protocol_find_sensor(uint32_t channel);
+static void protocol_select_framing(framing_t selected, size_t selected_fragment_size);
+static void protocol_command_config(const command_arg_t* args, size_t count);
+static void protocol_command_subscribe(const command_arg_t* args, size_t count);
+static void protocol_command_unsubscribe(const command_arg_t* args, size_t count);
+static void protocol_command_framing(const command_arg_t* args, size_t count);
+static void protocol_command_bench(const command_arg_t* args, size_t count);
+static void protocol_command_stats(const command_arg_t* args, size_t count);
+static void protocol_command_credit(const command_arg_t* args, size_t count);
+static void protocol_command_resend(const command_arg_t* args, size_t count);
+static void protocol_command_weight(const command_arg_t* args, size_t count);
+static void protocol_command_protocol(const command_arg_t* args, size_t count);
+static void protocol_command_heartbeat(const command_arg_t* args, size_t count);
+static void protocol_format_endpoint(char* field, uint8_t channel);
+static void protocol_send_stats(void);
+static void protocol_send_stats_items(void);
+static void protocol_put_u16(uint8_t* p, uint16_t value);
+static void protocol_put_u32(uint8_t* p, uint32_t value);
+
+
+/*******************************************************************************
+* Command Table
+*******************************************************************************/
+/* To add a command, add its handler here with a new code for binary
+ * requests; the arguments are parsed and checked against the list of types
+ * before the handler is called */
+static const command_t COMMANDS[] =
+{
+    { "config?",     1,  "?s",    protocol_command_config },
+    { "subscribe",   2,  "uu?us", protocol_command_subscribe },
+    { "unsubscribe", 3,  "?u",    protocol_command_unsubscribe },
+    { "heartbeat",   4,  "",      protocol_command_heartbeat },
+    { "stats?",      5,  "",      protocol_command_stats },
+    { "framing",     6,  "s?u",   protocol_command_framing },
+    { "bench",       7,  "uu",    protocol_command_bench },
+    { "credit",      8,  "uu?s",  protocol_command_credit },
+    { "resend",      9,  "uuu",   protocol_command_resend },
+    { "weight",      10, "uu",    protocol_command_weight },
+    { "protocol",    11, "u",     protocol_command_protocol },
+    { "",            0,  "",      protocol_command_heartbeat },
+};
+static command_table_t command_table;
 
 
 /*******************************************************************************
@@ -109,6 +283,168 @@ static uint32_t last_receive_time = 0;
 void protocol_init()
 {
     clock_init();
+    crc_init();
+    history_init();
+    scheduler_init();
+    command_table_init(&command_table, COMMANDS, sizeof(COMMANDS) / sizeof(COMMANDS[0]));
+}
+
+/*******************************************************************************
+* Function Name: protocol_get_config
+********************************************************************************
+* Summary:
+*  Returns the config message, built from the sensor registry. The message
+*  is cached and only rebuilt after sensors have been registered, which may
+*  happen after protocol_init(), or for another framing.
+*
+* Parameters:
+*  selected: framing of the session; only the sensors offered to hosts of
+*            that framing are listed, see protocol_is_offered()
+*
+*******************************************************************************/
+static const char* protocol_get_config(framing_t selected)
+{
+    if (config_generation == sensor_get_generation() && config_framing == selected)
+    {
+        return config_message;
+    }
+    config_generation = sensor_get_generation();
+    config_framing = selected;
+
+    int n = snprintf(config_message, sizeof(config_message), "%s", CONFIG_HEADER);
+    const char* separator = "";
+    const sensor_t* sensor;
+    for (size_t i = 0; (sensor = sensor_get(i)) != NULL && n < (int)sizeof(config_message); i++)
+    {
+        if (!protocol_is_offered(sensor, config_framing))
+        {
+            continue;
+        }
+
+        char rates[RATES_FIELD_SIZE];
+        char batch_sizes[RATES_FIELD_SIZE];
+        protocol_format_list(rates, sizeof(rates), sensor->rates, NULL, sensor->rate_count);
+        if (sensor->batch_size_count)
+        {
+            protocol_format_list(batch_sizes, sizeof(batch_sizes), NULL, sensor->batch_sizes, sensor->batch_size_count);
+        }
+        else
+        {
+            protocol_format_list(batch_sizes, sizeof(batch_sizes), NULL, &sensor->samples, 1);
+        }
+
+        /* Channels with an endpoint of their own report its address, so the
+         * host knows where to read them */
+        char endpoint[ENDPOINT_FIELD_SIZE];
+        protocol_format_endpoint(endpoint, sensor->channel);
+
+        char datatypes[DATATYPES_FIELD_SIZE];
+        protocol_format_datatypes(datatypes, sensor);
+
+        n += snprintf(config_message + n, sizeof(config_message) - n, CONFIG_SENSOR_FORMAT,
+                separator, sensor->channel, sensor->type, sensor->datatype,
+                sensor->samples, sensor->features, rates, batch_sizes, datatypes, endpoint);
+        separator = ",\r\n";
+    }
+    if (n < (int)sizeof(config_message))
+    {
+        snprintf(config_message + n, sizeof(config_message) - n, "%s", CONFIG_FOOTER);
+    }
+    return config_message;
+}
+
+/*******************************************************************************
+* Function Name: protocol_format_datatypes
+********************************************************************************
+* Summary:
+*  Formats the datatypes and scale fields of a sensor in the config message.
+*  The fields are empty if the sensor only sends its datatype.
+*
+* Parameters:
+*  field: buffer of DATATYPES_FIELD_SIZE bytes for the fields
+*  sensor: the sensor
+*
+*******************************************************************************/
+static void protocol_format_datatypes(char* field, const sensor_t* sensor)
+{
+    if (sensor->raw_datatype == NULL)
+    {
+        field[0] = 0;
+        return;
+    }
+
+    /* The printf of newlib-nano has no floating point support, so the
+     * scale is formatted as a decimal mantissa and exponent */
+    float value = sensor->raw_scale;
+    int exponent = 0;
+    while (value > 0.0f && value < 1.0f)
+    {
+        value *= 10.0f;
+        exponent--;
+    }
+    while (value >= 10.0f)
+    {
+        value /= 10.0f;
+        exponent++;
+    }
+    uint32_t mantissa = (uint32_t)(value * 1000000.0f + 0.5f);
+
+    snprintf(field, DATATYPES_FIELD_SIZE,
+            ",\r\n            \"datatypes\": [ \"%s\", \"%s\" ],"
+            "\r\n            \"scale\": %lu.%06lue%d",
+            sensor->datatype, sensor->raw_datatype,
+            (unsigned long)(mantissa / 1000000u), (unsigned long)(mantissa % 1000000u), exponent);
+}
+
+/*******************************************************************************
+* Function Name: protocol_format_list
+********************************************************************************
+* Summary:
+*  Formats a list of numbers for the config message, e.g. "50, 100". The
+*  numbers are taken from values or, if it is NULL, from values16.
+*
+* Parameters:
+*  field: buffer for the list
+*  field_size: size of the buffer
+*  values: the numbers, or NULL
+*  values16: the numbers, if values is NULL
+*  count: number of numbers
+*
+*******************************************************************************/
+static void protocol_format_list(char* field, size_t field_size, const uint32_t* values, const uint16_t* values16, size_t count)
+{
+    int length = 0;
+    field[0] = 0;
+    for (size_t i = 0; i < count && length < (int)field_size; i++)
+    {
+        length += snprintf(field + length, field_size - length, "%s%lu",
+                i ? ", " : "", (unsigned long)(values ? values[i] : values16[i]));
+    }
+}
+
+/*******************************************************************************
+* Function Name: protocol_format_endpoint
+********************************************************************************
+* Summary:
+*  Formats the endpoint field of a sensor in the config message. The field is
+*  empty if the channel is sent on the main link.
+*
+* Parameters:
+*  field: buffer of ENDPOINT_FIELD_SIZE bytes for the field
+*  channel: the channel of the sensor
+*
+*******************************************************************************/
+static void protocol_format_endpoint(char* field, uint8_t channel)
+{
+    uint8_t endpoint = streaming_get_channel_endpoint(channel);
+    if (endpoint)
+    {
+        snprintf(field, ENDPOINT_FIELD_SIZE, ",\r\n            \"endpoint\": %u", endpoint);
+    }
+    else
+    {
+        field[0] = 0;
+    }
 }
 
 /*******************************************************************************
@@ -116,8 +452,8 @@ void protocol_init()
 ********************************************************************************
 * Summary:
 *  Handles incoming characters, executes commands and sends response messages
-*  in a read-eval-print loop. This function may block until a response
-*  transmission is complete.
+*  in a read-eval-print loop. This function may block if the transmit queue
+*  is full.
 *
 *******************************************************************************/
 void protocol_repl()
@@ -125,6 +461,9 @@ void protocol_repl()
     /* Update clock */
     clock_update();
 
+    /* Send data the transport held back for coalescing */
+    streaming_poll();
+
     /* Test clock */
     /* Uncomment if desired!
     static uint32_t last_t = 0;
@@ -146,116 +485,1437 @@ void protocol_repl()
 
         /* Echo incoming characters when not streaming data */
         /* Uncomment if desired!
-        if (!subscribe_audio && !subscribe_imu)
+        if (!protocol_is_streaming())
             streaming_send(receive_p, bytes_read);
         */
 
         /* Advance receive pointer */
         receive_p += bytes_read;
 
-        /* Check for \r\n at end */
-        if (receive_p >= receive_buffer + 2 && *(receive_p - 2) == '\r' && *(receive_p - 1) == '\n')
+        /* Execute every complete command in the buffer; several pipelined
+         * commands may arrive in one read. In a version 2 session, a command
+         * may also be a binary request. */
+        char* command = receive_buffer;
+        for (char* p = receive_buffer; p < receive_p; p++)
         {
-            /* Remove \r\n */
-            *(receive_p - 2) = 0;
-
-            /* config? */
-            if (strcmp(receive_buffer, "config?") == 0)
-            {
-                subscribe_audio = subscribe_imu = false;
-                streaming_send(CONFIG_MESSAGE, strlen(CONFIG_MESSAGE));
-            }
-            /* subscribe,1,16000 */
-            else if (strcmp(receive_buffer, "subscribe,1,16000") == 0)
+            if (session_version >= 2 && p == command && (uint8_t)*p == PROTOCOL_V2_MAGIC)
             {
-                subscribe_audio = true;
+                size_t size = protocol_receive_frame((const uint8_t*)p, receive_p - p);
+                if (size == 0)
+                {
+                    break;
+                }
+                command = p + size;
+                p = command - 1;
             }
-            /* unsubscribe,1 */
-            else if (strcmp(receive_buffer, "unsubscribe,1") == 0)
+            else if (p + 1 < receive_p && p[0] == '\r' && p[1] == '\n')
             {
-                subscribe_audio = false;
-                streaming_send(OK_MESSAGE, strlen(OK_MESSAGE));
+                /* Remove \r\n */
+                *p = 0;
+                protocol_execute(command);
+                command = p + 2;
+                p++;
             }
-#if IM_ENABLE_IMU
-            /* subscribe,2,50 */
-            else if (strcmp(receive_buffer, "subscribe,2,50") == 0)
-            {
-                subscribe_imu = true;
-            }
-            /* unsubscribe,2 */
-            else if (strcmp(receive_buffer, "unsubscribe,2") == 0)
-            {
-                subscribe_imu = false;
-                streaming_send(OK_MESSAGE, strlen(OK_MESSAGE));
-            }
-#endif
-            /* unsubscribe */
-            else if (strcmp(receive_buffer, "unsubscribe") == 0)
-            {
-                subscribe_audio = subscribe_imu = false;
-                streaming_send(OK_MESSAGE, strlen(OK_MESSAGE));
-            }
-            /* empty command or heartbeat */
-            else if (*receive_buffer == 0 || strcmp(receive_buffer, "heartbeat") == 0)
-            {
-                /* Nothing to do except register receive time, which was done above */
-            }
-            else
-            {
-                streaming_send(UNRECOGNIZED_COMMAND_MESSAGE, strlen(UNRECOGNIZED_COMMAND_MESSAGE));
-            }
-
-            /* Reset receive pointer; ready for new command */
-            receive_p = receive_buffer;
         }
 
+        /* Keep any partial command at the start of the buffer */
+        size_t remaining = receive_p - command;
+        memmove(receive_buffer, command, remaining);
+        receive_p = receive_buffer + remaining;
+
         /* Check end of buffer */
         if (receive_p == receive_buffer + RECEIVE_BUFFER_SIZE)
         {
-            streaming_send(TOO_LONG_COMMAND_MESSAGE, strlen(TOO_LONG_COMMAND_MESSAGE));
+            protocol_send_status(STATUS_TOO_LONG_COMMAND);
             receive_p = receive_buffer;
         }
     }
 
+    /* Send packets that waited for credit or for room in the queue */
+    const sensor_t* sensor;
+    for (size_t i = 0; (sensor = sensor_get(i)) != NULL; i++)
+    {
+        protocol_send_backlog(sensor->channel);
+    }
+    protocol_send_scheduled();
+
+    /* While the link is down, the host cannot send heartbeats; keep the
+     * subscriptions so streaming resumes as soon as the link is back */
+    if (!streaming_is_connected())
+    {
+        last_receive_time = clock_get_ms();
+    }
+
     /* Check receive timeout: If no message for 5 seconds, stop streaming */
-    if ((subscribe_audio || subscribe_imu) && clock_get_ms() - last_receive_time > HEARTBEAT_TIMEOUT_MS)
+    if (protocol_is_streaming() && clock_get_ms() - last_receive_time > HEARTBEAT_TIMEOUT_MS)
     {
-        subscribe_audio = subscribe_imu = false;
+        protocol_unsubscribe_all();
+        protocol_send_notification(PROTOCOL_EVENT_STREAMING_STOPPED);
     }
 }
 
 /*******************************************************************************
-* Function Name: protocol_send
+* Function Name: protocol_execute
 ********************************************************************************
 * Summary:
-*  Sends a packet of data to the host. This function may block until the
-*  transmission is complete.
+*  Executes one command and sends the response message, if any.
 *
 * Parameters:
-*  channel: the channel (1-9) to send the packet on
-*  data: pointer to data to send
-*  size: number of bytes to send
+*  command: the command, without the trailing \r\n; it is modified
+*
+*******************************************************************************/
+static void protocol_execute(char* command)
+{
+    protocol_send_result(command_execute(&command_table, command));
+}
+
+/*******************************************************************************
+* Function Name: protocol_receive_frame
+********************************************************************************
+* Summary:
+*  Checks a binary request at the start of the data and executes it once it
+*  is complete. Data that starts with the magic byte but is no valid
+*  request is skipped byte by byte, like text that is no command.
+*
+* Parameters:
+*  data: received data starting with PROTOCOL_V2_MAGIC
+*  size: number of bytes received
+*
+* Return:
+*  Number of bytes used, or 0 if the request is not complete yet.
+*
+*******************************************************************************/
+static size_t protocol_receive_frame(const uint8_t* data, size_t size)
+{
+    if (size < PROTOCOL_V2_HEADER_SIZE)
+    {
+        return 0;
+    }
+    size_t length = tlv_get_uint(data + 2, 2);
+    if (PROTOCOL_V2_HEADER_SIZE + length > RECEIVE_BUFFER_SIZE)
+    {
+        return 1;
+    }
+    if (size < PROTOCOL_V2_HEADER_SIZE + length)
+    {
+        return 0;
+    }
+
+    crc_start();
+    crc_update(data, 12);
+    crc_update(data + PROTOCOL_V2_HEADER_SIZE, length);
+    if (crc_finish() != tlv_get_uint(data + 12, 4) || data[1] != PROTOCOL_CONTROL_CHANNEL)
+    {
+        return 1;
+    }
+
+    protocol_execute_request((uint16_t)tlv_get_uint(data + 4, 2), data + PROTOCOL_V2_HEADER_SIZE, length);
+    return PROTOCOL_V2_HEADER_SIZE + length;
+}
+
+/*******************************************************************************
+* Function Name: protocol_execute_request
+********************************************************************************
+* Summary:
+*  Executes a binary request: a command item with the code of the command,
+*  followed by an item for each argument. The responses carry the sequence
+*  number of the request; a request whose command sends no response of its
+*  own, e.g. subscribe, is answered with the OK status, so the host can tell
+*  every request was received.
+*
+* Parameters:
+*  number: sequence number of the request frame
+*  payload: the items of the request
+*  size: size of the payload
 *
 *******************************************************************************/
-void protocol_send(uint8_t channel, const uint8_t* data, size_t size)
+static void protocol_execute_request(uint16_t number, const uint8_t* payload, size_t size)
 {
-    uint8_t header[2] = { 'B', '0' + channel };
-    switch (channel)
+    command_arg_t args[COMMAND_MAX_ARGS];
+    char types[COMMAND_MAX_ARGS];
+    /* String arguments, each with a terminating zero added */
+    char strings[RECEIVE_BUFFER_SIZE];
+    size_t used = 0;
+    size_t count = 0;
+    tlv_reader_t reader;
+    uint8_t type;
+    const uint8_t* value;
+    size_t length;
+
+    request_number = number;
+    request_answered = false;
+    tlv_reader_init(&reader, payload, size);
+    if (!tlv_next(&reader, &type, &value, &length) || type != PROTOCOL_TLV_COMMAND || length != 1)
+    {
+        protocol_send_status(STATUS_UNRECOGNIZED_COMMAND);
+        request_number = -1;
+        return;
+    }
+    uint8_t code = value[0];
+
+    while (tlv_next(&reader, &type, &value, &length))
     {
-    case PROTOCOL_AUDIO_CHANNEL:
-        if (subscribe_audio)
+        if (count == COMMAND_MAX_ARGS)
+        {
+            break;
+        }
+        if (type == PROTOCOL_TLV_UINT && length <= sizeof(uint32_t))
+        {
+            args[count].u = tlv_get_uint(value, length);
+            types[count++] = 'u';
+        }
+        else if (type == PROTOCOL_TLV_STRING && used + length < sizeof(strings))
+        {
+            memcpy(strings + used, value, length);
+            strings[used + length] = 0;
+            args[count].s = strings + used;
+            types[count++] = 's';
+            used += length + 1;
+        }
+        else
         {
-            streaming_send(header, 2);
-            streaming_send(data, size);
-            streaming_send(CRLF, 2);
+            break;
         }
+    }
+
+    if (reader.position != reader.size)
+    {
+        /* An argument of an unknown type, or one too many */
+        protocol_send_status(STATUS_INVALID_ARGUMENT);
+    }
+    else
+    {
+        protocol_send_result(command_execute_code(&command_table, code, types, args, count));
+    }
+    if (!request_answered && session_version >= 2)
+    {
+        protocol_send_status(STATUS_OK);
+    }
+    request_number = -1;
+}
+
+/*******************************************************************************
+* Function Name: protocol_send_result
+********************************************************************************
+* Summary:
+*  Sends the error response if a command could not be executed. The
+*  handler of an executed command sends its own response, if any.
+*
+*******************************************************************************/
+static void protocol_send_result(command_result_t result)
+{
+    switch (result)
+    {
+    case COMMAND_UNRECOGNIZED:
+        protocol_send_status(STATUS_UNRECOGNIZED_COMMAND);
+        break;
+    case COMMAND_INVALID_ARGUMENT:
+        protocol_send_status(STATUS_INVALID_ARGUMENT);
         break;
-    case PROTOCOL_IMU_CHANNEL:
-        if (subscribe_imu)
+    default:
+        break;
+    }
+}
+
+/*******************************************************************************
+* Function Name: protocol_send_status
+********************************************************************************
+* Summary:
+*  Sends the response for the outcome of a request: text in a version 1
+*  session, a control message with the status in version 2.
+*
+*******************************************************************************/
+static void protocol_send_status(protocol_status_t status)
+{
+    if (session_version < 2)
+    {
+        protocol_send_text(STATUS_MESSAGES[status]);
+        return;
+    }
+
+    tlv_writer_t writer;
+    protocol_begin_control(&writer);
+    tlv_put_u8(&writer, PROTOCOL_TLV_STATUS, (uint8_t)status);
+    protocol_send_control(&writer);
+}
+
+/*******************************************************************************
+* Function Name: protocol_send_notification
+********************************************************************************
+* Summary:
+*  Tells the host of an event it did not ask about, in a version 2 session.
+*  Version 1 has no notifications.
+*
+* Parameters:
+*  event: the event, PROTOCOL_EVENT_...
+*
+*******************************************************************************/
+static void protocol_send_notification(uint8_t event)
+{
+    if (session_version < 2)
+    {
+        return;
+    }
+
+    tlv_writer_t writer;
+    protocol_begin_control(&writer);
+    tlv_put_u8(&writer, PROTOCOL_TLV_NOTIFICATION, event);
+    protocol_send_control(&writer);
+}
+
+/*******************************************************************************
+* Function Name: protocol_begin_control
+********************************************************************************
+* Summary:
+*  Starts a control message. A response to a binary request starts with
+*  the sequence number of the request.
+*
+*******************************************************************************/
+static void protocol_begin_control(tlv_writer_t* writer)
+{
+    tlv_begin(writer, control_message, sizeof(control_message));
+    if (request_number >= 0)
+    {
+        tlv_put_u16(writer, PROTOCOL_TLV_REQUEST, (uint16_t)request_number);
+        request_answered = true;
+    }
+}
+
+/*******************************************************************************
+* Function Name: protocol_send_control
+********************************************************************************
+* Summary:
+*  Sends a control message on the control channel, in the current framing,
+*  which is v2 or cobs in a version 2 session.
+*
+*******************************************************************************/
+static void protocol_send_control(const tlv_writer_t* writer)
+{
+    protocol_send_frame_numbered(PROTOCOL_CONTROL_CHANNEL, sequence[PROTOCOL_CONTROL_CHANNEL]++, 0, 0,
+                                 control_message, writer->length, clock_now_us());
+}
+
+/*******************************************************************************
+* Function Name: protocol_unsubscribe_all
+********************************************************************************
+* Summary:
+*  Stops all sensor data streaming.
+*
+*******************************************************************************/
+static void protocol_unsubscribe_all(void)
+{
+    memset(subscriptions, 0, sizeof(subscriptions));
+    credit_reset();
+    scheduler_clear();
+}
+
+/*******************************************************************************
+* Function Name: protocol_is_streaming
+********************************************************************************
+* Summary:
+*  Returns true if any channel is subscribed.
+*
+*******************************************************************************/
+static bool protocol_is_streaming(void)
+{
+    const sensor_t* sensor;
+    for (size_t i = 0; (sensor = sensor_get(i)) != NULL; i++)
+    {
+        if (subscriptions[sensor->channel].active)
         {
-            streaming_send(header, 2);
-            streaming_send(data, size);
-            streaming_send(CRLF, 2);
+            return true;
         }
     }
+    return false;
+}
+
+/*******************************************************************************
+* Function Name: protocol_get_max_channel
+********************************************************************************
+* Summary:
+*  Returns the highest channel a framing can carry. v1 and the aligned
+*  framings send the channel as one ASCII digit, so their hosts only see
+*  channels 1-9; v2 and cobs send it as a byte.
+*
+*******************************************************************************/
+static uint8_t protocol_get_max_channel(framing_t selected)
+{
+    if (selected == FRAMING_V2 || selected == FRAMING_COBS)
+    {
+        return PROTOCOL_MAX_CHANNEL;
+    }
+    return PROTOCOL_MAX_V1_CHANNEL;
+}
+
+/*******************************************************************************
+* Function Name: protocol_find_framing
+********************************************************************************
+* Summary:
+*  Looks up a framing by the name used in commands.
+*
+* Parameters:
+*  name: name of the framing, e.g. "v2"
+*  found: set to the framing if found
+*
+* Return:
+*  True if there is a framing with the name.
+*
+*******************************************************************************/
+static bool protocol_find_framing(const char* name, framing_t* found)
+{
+    for (size_t i = 0; i < sizeof(FRAMING_NAMES) / sizeof(FRAMING_NAMES[0]); i++)
+    {
+        if (strcmp(name, FRAMING_NAMES[i]) == 0)
+        {
+            *found = (framing_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*******************************************************************************
+* Function Name: protocol_is_offered
+********************************************************************************
+* Summary:
+*  Returns true if hosts that use the framing are offered the sensor. The
+*  framing must carry its channel, and the combined channel is only offered
+*  with v2 and cobs, like the channels above 9, since hosts that stay with
+*  v1 do not know its mux datatype.
+*
+*******************************************************************************/
+static bool protocol_is_offered(const sensor_t* sensor, framing_t selected)
+{
+    if (sensor->channel > protocol_get_max_channel(selected))
+    {
+        return false;
+    }
+    return selected == FRAMING_V2 || selected == FRAMING_COBS || strcmp(sensor->datatype, "mux") != 0;
+}
+
+/*******************************************************************************
+* Function Name: protocol_find_sensor
+********************************************************************************
+* Summary:
+*  Returns the sensor of a channel given in a command, or NULL if no sensor
+*  uses the channel or it is not offered in the current framing.
+*
+*******************************************************************************/
+static const sensor_t* protocol_find_sensor(uint32_t channel)
+{
+    if (channel > protocol_get_max_channel(framing))
+    {
+        return NULL;
+    }
+    const sensor_t* sensor = sensor_find((uint8_t)channel);
+    return sensor != NULL && protocol_is_offered(sensor, framing) ? sensor : NULL;
+}
+
+/*******************************************************************************
+* Function Name: protocol_select_framing
+********************************************************************************
+* Summary:
+*  Switches to a framing. The sequence numbers restart, packets still
+*  queued are dropped and channels the framing does not offer stop streaming.
+*
+* Parameters:
+*  selected: the framing
+*  selected_fragment_size: largest payload of a frame of a scheduled
+*                          channel, or 0 for whole packets
+*
+*******************************************************************************/
+static void protocol_select_framing(framing_t selected, size_t selected_fragment_size)
+{
+    framing = selected;
+    fragment_size = selected_fragment_size;
+    memset(sequence, 0, sizeof(sequence));
+    history_clear();
+    credit_clear();
+    scheduler_clear();
+
+    for (size_t channel = protocol_get_max_channel(framing) + 1u; channel <= PROTOCOL_MAX_CHANNEL; channel++)
+    {
+        subscriptions[channel].active = false;
+        credit_disable((uint8_t)channel);
+    }
+
+    /* Also end subscriptions to sensors no longer offered, e.g. the combined
+     * channel after a switch to v1 */
+    const sensor_t* sensor;
+    for (size_t i = 0; (sensor = sensor_get(i)) != NULL; i++)
+    {
+        if (!protocol_is_offered(sensor, framing))
+        {
+            subscriptions[sensor->channel].active = false;
+            credit_disable(sensor->channel);
+        }
+    }
+}
+
+/* config?[,<framing>] */
+static void protocol_command_config(const command_arg_t* args, size_t count)
+{
+    /* A new session starts in v1, which v1 hosts expect, unless the host
+     * names the framing it will use; the response lists the channels that
+     * framing can carry */
+    framing_t selected = FRAMING_V1;
+    if (count > 0 && !protocol_find_framing(args[0].s, &selected))
+    {
+        protocol_send_status(STATUS_INVALID_ARGUMENT);
+        return;
+    }
+
+    /* A text config? also ends a version 2 session, so a v1 host that
+     * connects after a v2 host gets the responses it expects. A binary one
+     * keeps the session and its framing, unless it names another. */
+    if (request_number < 0)
+    {
+        session_version = 1;
+    }
+    if (session_version >= 2)
+    {
+        if (count == 0)
+        {
+            selected = framing;
+        }
+        else if (selected != FRAMING_V2 && selected != FRAMING_COBS)
+        {
+            protocol_send_status(STATUS_UNSUPPORTED_FRAMING);
+            return;
+        }
+        protocol_unsubscribe_all();
+        protocol_send_config();
+        protocol_select_framing(selected, 0);
+        return;
+    }
+
+    protocol_unsubscribe_all();
+    framing = FRAMING_V1;
+    protocol_send_text(protocol_get_config(selected));
+    protocol_select_framing(selected, 0);
+}
+
+/* subscribe,<channel>,<rate>[,<samples per packet>[,<datatype>]] */
+static void protocol_command_subscribe(const command_arg_t* args, size_t count)
+{
+    const sensor_t* sensor = protocol_find_sensor(args[0].u);
+    if (sensor == NULL)
+    {
+        protocol_send_status(STATUS_UNKNOWN_CHANNEL);
+        return;
+    }
+
+    /* Without the optional arguments, the packets have the shape and
+     * datatype given by the config message, as with v1 hosts */
+    uint32_t samples_per_packet = count > 2 ? args[2].u : sensor->samples;
+    const char* datatype = sensor->datatype;
+    if (count > 3 && sensor->raw_datatype != NULL && strcmp(args[3].s, sensor->raw_datatype) == 0)
+    {
+        datatype = sensor->raw_datatype;
+    }
+
+    if (!sensor_supports_rate(sensor, args[1].u))
+    {
+        protocol_send_status(STATUS_UNSUPPORTED_RATE);
+    }
+    else if (!sensor_supports_batch_size(sensor, samples_per_packet) ||
+             samples_per_packet * sensor_get_sample_size(sensor, datatype) > PROTOCOL_MAX_PAYLOAD_SIZE)
+    {
+        protocol_send_status(STATUS_UNSUPPORTED_BATCH_SIZE);
+    }
+    else if (count > 3 && strcmp(args[3].s, datatype) != 0)
+    {
+        protocol_send_status(STATUS_UNSUPPORTED_DATATYPE);
+    }
+    else
+    {
+        protocol_subscription_t* subscription = &subscriptions[sensor->channel];
+        subscription->rate = args[1].u;
+        subscription->samples_per_packet = (uint16_t)samples_per_packet;
+        subscription->datatype = datatype;
+        subscription->fill = 0;
+        subscription->active = true;
+    }
+}
+
+/* unsubscribe[,<channel>] */
+static void protocol_command_unsubscribe(const command_arg_t* args, size_t count)
+{
+    if (count == 0)
+    {
+        protocol_unsubscribe_all();
+    }
+    else if (protocol_find_sensor(args[0].u) != NULL)
+    {
+        subscriptions[args[0].u].active = false;
+        credit_disable((uint8_t)args[0].u);
+    }
+    else
+    {
+        protocol_send_status(STATUS_UNKNOWN_CHANNEL);
+        return;
+    }
+    protocol_send_status(STATUS_OK);
+}
+
+/* credit,<channel>,<amount>[,<packets|bytes>] */
+static void protocol_command_credit(const command_arg_t* args, size_t count)
+{
+    credit_unit_t unit = CREDIT_PACKETS;
+    if (count > 2 && strcmp(args[2].s, "bytes") == 0)
+    {
+        unit = CREDIT_BYTES;
+    }
+    else if (count > 2 && strcmp(args[2].s, "packets") != 0)
+    {
+        protocol_send_status(STATUS_INVALID_ARGUMENT);
+        return;
+    }
+
+    const sensor_t* sensor = protocol_find_sensor(args[0].u);
+    if (sensor == NULL)
+    {
+        protocol_send_status(STATUS_UNKNOWN_CHANNEL);
+    }
+    else if (!credit_grant(sensor->channel, args[1].u, unit))
+    {
+        protocol_send_status(STATUS_NO_BACKLOG);
+    }
+    else
+    {
+        /* No response; grants are frequent and the data is the answer */
+        protocol_send_backlog(sensor->channel);
+    }
+}
+
+/* resend,<channel>,<first sequence>,<last sequence> */
+static void protocol_command_resend(const command_arg_t* args, size_t count)
+{
+    uint8_t channel = (uint8_t)args[0].u;
+    if (protocol_find_sensor(args[0].u) == NULL)
+    {
+        protocol_send_status(STATUS_UNKNOWN_CHANNEL);
+        return;
+    }
+    if (!history_is_kept(channel))
+    {
+        protocol_send_status(STATUS_NO_HISTORY);
+        return;
+    }
+    if (framing != FRAMING_V2 && framing != FRAMING_COBS)
+    {
+        /* Without sequence numbers, the host cannot tell resent packets */
+        protocol_send_status(STATUS_UNSUPPORTED_FRAMING);
+        return;
+    }
+    if (args[1].u > UINT16_MAX || args[2].u > UINT16_MAX)
+    {
+        protocol_send_status(STATUS_INVALID_ARGUMENT);
+        return;
+    }
+
+    /* The range may wrap around from 65535 to 0. The packets are resent in
+     * the order they were numbered, ahead of packets still in a backlog. */
+    uint16_t first = (uint16_t)args[1].u;
+    uint32_t requested = (uint16_t)(args[2].u - first) + 1u;
+    uint32_t hits = 0;
+    packet_ring_entry_t packet;
+    const uint8_t* data;
+    size_t position = 0;
+    while ((data = history_next(channel, &position, &packet)) != NULL)
+    {
+        if ((uint16_t)(packet.sequence - first) < requested)
+        {
+            protocol_send_frame_numbered(channel, packet.sequence, PROTOCOL_V2_FLAG_RETRANSMIT, 0,
+                                         data, packet.size, packet.timestamp);
+            hits++;
+        }
+    }
+    history_count(channel, hits, requested - hits);
+    protocol_send_status(STATUS_OK);
+}
+
+/* weight,<channel>,<quantum> */
+static void protocol_command_weight(const command_arg_t* args, size_t count)
+{
+    if (protocol_find_sensor(args[0].u) == NULL || !scheduler_is_scheduled((uint8_t)args[0].u))
+    {
+        protocol_send_status(STATUS_UNKNOWN_CHANNEL);
+        return;
+    }
+    if (args[1].u > UINT16_MAX || !scheduler_set_quantum((uint8_t)args[0].u, args[1].u))
+    {
+        protocol_send_status(STATUS_INVALID_ARGUMENT);
+        return;
+    }
+    protocol_send_status(STATUS_OK);
+}
+
+/* framing,<v1|v2|cobs|align4|align8>[,<fragment size>] */
+static void protocol_command_framing(const command_arg_t* args, size_t count)
+{
+    framing_t selected;
+    if (!protocol_find_framing(args[0].s, &selected))
+    {
+        protocol_send_status(STATUS_INVALID_ARGUMENT);
+        return;
+    }
+
+    /* Only the v2 header can mark fragments */
+    bool v2_header = selected == FRAMING_V2 || selected == FRAMING_COBS;
+    uint32_t size = count > 1 ? args[1].u : 0;
+    if (size != 0 && (size < MIN_FRAGMENT_SIZE || size > PROTOCOL_MAX_PAYLOAD_SIZE || !v2_header))
+    {
+        protocol_send_status(STATUS_INVALID_ARGUMENT);
+        return;
+    }
+    /* Control messages of a version 2 session need the v2 header too */
+    if (session_version >= 2 && !v2_header)
+    {
+        protocol_send_status(STATUS_UNSUPPORTED_FRAMING);
+        return;
+    }
+
+    /* The response still uses the previous framing */
+    protocol_send_status(STATUS_OK);
+    protocol_select_framing(selected, size);
+}
+
+/* protocol,<version> */
+static void protocol_command_protocol(const command_arg_t* args, size_t count)
+{
+    if (args[0].u != 1 && args[0].u != 2)
+    {
+        protocol_send_status(STATUS_UNSUPPORTED_VERSION);
+        return;
+    }
+
+    /* The response still uses the previous version */
+    protocol_send_status(STATUS_OK);
+    session_version = (uint8_t)args[0].u;
+    if (session_version >= 2 && framing != FRAMING_V2 && framing != FRAMING_COBS)
+    {
+        protocol_select_framing(FRAMING_V2, 0);
+    }
+}
+
+/* bench,<bytes>,<chunk> */
+static void protocol_command_bench(const command_arg_t* args, size_t count)
+{
+    if (args[1].u < BENCH_HEADER_SIZE || args[1].u > BENCH_MAX_CHUNK)
+    {
+        protocol_send_status(STATUS_INVALID_ARGUMENT);
+        return;
+    }
+    protocol_unsubscribe_all();
+    bench_run(args[0].u, args[1].u);
+}
+
+/* stats? */
+static void protocol_command_stats(const command_arg_t* args, size_t count)
+{
+    protocol_send_stats();
+}
+
+/* heartbeat, or an empty command */
+static void protocol_command_heartbeat(const command_arg_t* args, size_t count)
+{
+    /* Nothing to do except register receive time, which was done when the
+     * command was received */
+}
+
+/*******************************************************************************
+* Function Name: protocol_send_stats
+********************************************************************************
+* Summary:
+*  Sends the stats? response: the transfer statistics of the link and the
+*  packet accounting of each channel, as JSON, or as control message items
+*  in a version 2 session.
+*
+*******************************************************************************/
+static void protocol_send_stats(void)
+{
+    static char message[STATS_MESSAGE_SIZE];
+    const sensor_t* sensor;
+    streaming_stats_t link;
+    int n;
+
+    if (session_version >= 2)
+    {
+        protocol_send_stats_items();
+        return;
+    }
+
+    streaming_get_stats(&link);
+    n = snprintf(message, sizeof(message),
+            "{\r\n"
+            "    \"link\": {\r\n"
+            "        \"bytes_sent\": %lu,\r\n"
+            "        \"bytes_received\": %lu,\r\n"
+            "        \"bytes_dropped\": %lu,\r\n"
+            "        \"transfers\": %lu,\r\n"
+            "        \"stalls\": %lu,\r\n"
+            "        \"queued\": %lu,\r\n"
+            "        \"queued_peak\": %lu,\r\n"
+            "        \"capacity\": %lu\r\n"
+            "    },\r\n",
+            (unsigned long)link.bytes_sent, (unsigned long)link.bytes_received,
+            (unsigned long)link.bytes_dropped, (unsigned long)link.transfers,
+            (unsigned long)link.stalls, (unsigned long)link.queued,
+            (unsigned long)link.queued_peak, (unsigned long)link.capacity);
+#if defined(COMPONENT_USBD_BASE) && IM_ENABLE_USB_AUDIO
+    usb_audio_stats_t audio;
+    usb_audio_get_stats(&audio);
+    n += snprintf(message + n, sizeof(message) - n,
+            "    \"usb_audio\": {\r\n"
+            "        \"packets\": %lu,\r\n"
+            "        \"underruns\": %lu,\r\n"
+            "        \"overruns\": %lu\r\n"
+            "    },\r\n",
+            (unsigned long)audio.packets, (unsigned long)audio.underruns,
+            (unsigned long)audio.overruns);
+#endif
+    n += snprintf(message + n, sizeof(message) - n, "    \"channels\": [");
+
+    const char* separator = "\r\n";
+    for (size_t i = 0; (sensor = sensor_get(i)) != NULL && n < (int)sizeof(message); i++)
+    {
+        if (!protocol_is_offered(sensor, framing))
+        {
+            continue;
+        }
+
+        backpressure_stats_t stats;
+        credit_stats_t credit;
+        history_stats_t history;
+        scheduler_stats_t queue;
+        backpressure_get_stats(sensor->channel, &stats);
+        credit_get_stats(sensor->channel, &credit);
+        history_get_stats(sensor->channel, &history);
+        scheduler_get_stats(sensor->channel, &queue);
+        n += snprintf(message + n, sizeof(message) - n,
+                "%s        { \"channel\": %u, \"sent\": %lu, \"dropped\": %lu, "
+                "\"decimated\": %lu, \"overruns\": %lu, \"credit\": %lu, "
+                "\"backlog\": %lu, \"backlog_dropped\": %lu, "
+                "\"resent\": %lu, \"resend_missed\": %lu, "
+                "\"weight\": %lu, \"queue_packets\": %lu, \"queue_dropped\": %lu, "
+                "\"queue_latency_us\": %lu, \"queue_latency_max_us\": %lu }",
+                separator, sensor->channel, (unsigned long)stats.sent, (unsigned long)stats.dropped,
+                (unsigned long)stats.decimated, (unsigned long)stats.overruns,
+                (unsigned long)credit.credit, (unsigned long)credit.backlog,
+                (unsigned long)credit.dropped, (unsigned long)history.hits,
+                (unsigned long)history.misses, (unsigned long)queue.quantum,
+                (unsigned long)queue.queued, (unsigned long)queue.dropped,
+                (unsigned long)queue.latency_us, (unsigned long)queue.latency_max_us);
+        separator = ",\r\n";
+    }
+    if (n < (int)sizeof(message))
+    {
+        snprintf(message + n, sizeof(message) - n, "\r\n    ]\r\n}\r\n");
+    }
+
+    protocol_send_text(message);
+}
+
+/*******************************************************************************
+* Function Name: protocol_send_stats_items
+********************************************************************************
+* Summary:
+*  Sends the stats? response of a version 2 session: a link stats item and
+*  a channel stats item per channel, with the counters in the order of the
+*  JSON response.
+*
+*******************************************************************************/
+static void protocol_send_stats_items(void)
+{
+    const sensor_t* sensor;
+    streaming_stats_t link;
+    tlv_writer_t writer;
+
+    streaming_get_stats(&link);
+    protocol_begin_control(&writer);
+    tlv_put_u8(&writer, PROTOCOL_TLV_STATUS, STATUS_OK);
+    size_t item = tlv_open(&writer, PROTOCOL_TLV_LINK_STATS);
+    tlv_append_u32(&writer, link.bytes_sent);
+    tlv_append_u32(&writer, link.bytes_received);
+    tlv_append_u32(&writer, link.bytes_dropped);
+    tlv_append_u32(&writer, link.transfers);
+    tlv_append_u32(&writer, link.stalls);
+    tlv_append_u32(&writer, link.queued);
+    tlv_append_u32(&writer, link.queued_peak);
+    tlv_append_u32(&writer, link.capacity);
+    tlv_close(&writer, item);
+#if defined(COMPONENT_USBD_BASE) && IM_ENABLE_USB_AUDIO
+    usb_audio_stats_t audio;
+    usb_audio_get_stats(&audio);
+    item = tlv_open(&writer, PROTOCOL_TLV_USB_AUDIO_STATS);
+    tlv_append_u32(&writer, audio.packets);
+    tlv_append_u32(&writer, audio.underruns);
+    tlv_append_u32(&writer, audio.overruns);
+    tlv_close(&writer, item);
+#endif
+
+    for (size_t i = 0; (sensor = sensor_get(i)) != NULL; i++)
+    {
+        backpressure_stats_t stats;
+        credit_stats_t credit;
+        history_stats_t history;
+        scheduler_stats_t queue;
+        backpressure_get_stats(sensor->channel, &stats);
+        credit_get_stats(sensor->channel, &credit);
+        history_get_stats(sensor->channel, &history);
+        scheduler_get_stats(sensor->channel, &queue);
+
+        const uint32_t counters[CHANNEL_COUNTERS] =
+        {
+            stats.sent, stats.dropped, stats.decimated, stats.overruns,
+            credit.credit, credit.backlog, credit.dropped,
+            history.hits, history.misses,
+            queue.quantum, queue.queued, queue.dropped, queue.latency_us, queue.latency_max_us,
+        };
+        item = tlv_open(&writer, PROTOCOL_TLV_CHANNEL_STATS);
+        tlv_append(&writer, &sensor->channel, 1);
+        for (size_t c = 0; c < CHANNEL_COUNTERS; c++)
+        {
+            tlv_append_u32(&writer, counters[c]);
+        }
+        tlv_close(&writer, item);
+    }
+
+    protocol_send_control(&writer);
+}
+
+/*******************************************************************************
+* Function Name: protocol_send_config
+********************************************************************************
+* Summary:
+*  Sends the config? response of a version 2 session: the same fields as
+*  the JSON configuration, as control message items with a sensor item
+*  per channel.
+*
+*******************************************************************************/
+static void protocol_send_config(void)
+{
+    const sensor_t* sensor;
+    tlv_writer_t writer;
+
+    protocol_begin_control(&writer);
+    tlv_put_u8(&writer, PROTOCOL_TLV_STATUS, STATUS_OK);
+    tlv_put_string(&writer, PROTOCOL_TLV_DEVICE_NAME, DEVICE_NAME);
+    tlv_put_u16(&writer, PROTOCOL_TLV_HEARTBEAT_TIMEOUT, HEARTBEAT_TIMEOUT_MS / 1000);
+
+    for (size_t i = 0; (sensor = sensor_get(i)) != NULL; i++)
+    {
+        size_t item = tlv_open(&writer, PROTOCOL_TLV_SENSOR);
+        tlv_put_u8(&writer, PROTOCOL_TLV_CHANNEL, sensor->channel);
+        tlv_put_string(&writer, PROTOCOL_TLV_TYPE, sensor->type);
+        tlv_put_string(&writer, PROTOCOL_TLV_DATATYPE, sensor->datatype);
+
+        size_t field = tlv_open(&writer, PROTOCOL_TLV_SHAPE);
+        tlv_append_u16(&writer, sensor->samples);
+        tlv_append_u16(&writer, sensor->features);
+        tlv_close(&writer, field);
+
+        field = tlv_open(&writer, PROTOCOL_TLV_RATES);
+        for (size_t r = 0; r < sensor->rate_count; r++)
+        {
+            tlv_append_u32(&writer, sensor->rates[r]);
+        }
+        tlv_close(&writer, field);
+
+        field = tlv_open(&writer, PROTOCOL_TLV_BATCH_SIZES);
+        for (size_t b = 0; b < sensor->batch_size_count; b++)
+        {
+            tlv_append_u16(&writer, sensor->batch_sizes[b]);
+        }
+        if (sensor->batch_size_count == 0)
+        {
+            tlv_append_u16(&writer, sensor->samples);
+        }
+        tlv_close(&writer, field);
+
+        if (sensor->raw_datatype != NULL)
+        {
+            uint32_t scale;
+            memcpy(&scale, &sensor->raw_scale, sizeof(scale));
+            tlv_put_string(&writer, PROTOCOL_TLV_RAW_DATATYPE, sensor->raw_datatype);
+            tlv_put_u32(&writer, PROTOCOL_TLV_SCALE, scale);
+        }
+        uint8_t endpoint = streaming_get_channel_endpoint(sensor->channel);
+        if (endpoint)
+        {
+            tlv_put_u8(&writer, PROTOCOL_TLV_ENDPOINT, endpoint);
+        }
+        tlv_close(&writer, item);
+    }
+
+    protocol_send_control(&writer);
+}
+
+/*******************************************************************************
+* Function Name: protocol_send
+********************************************************************************
+* Summary:
+*  Sends sensor data to the host if the channel is subscribed. The data is
+*  cut into or collected in packets of the number of samples per packet of
+*  the subscription; each packet is stamped with the capture time of its
+*  last sample. Packets are queued for transmission; this function only
+*  blocks if the transmit queue is full.
+*
+* Parameters:
+*  channel: the channel (1-255) to send the data on
+*  data: pointer to data to send, a whole number of samples
+*  size: number of bytes to send
+*  timestamp: capture time of the last sample in us, see clock_now_us()
+*
+*******************************************************************************/
+void protocol_send(uint8_t channel, const uint8_t* data, size_t size, uint32_t timestamp)
+{
+    if (!subscriptions[channel].active)
+    {
+        return;
+    }
+
+    protocol_subscription_t* subscription = &subscriptions[channel];
+    const sensor_t* sensor = sensor_find(channel);
+    size_t sample_size = sensor_get_sample_size(sensor, subscription->datatype);
+    size_t packet_size = subscription->samples_per_packet * sample_size;
+
+    /* Data that already has the packet size is sent as is, and so are the
+     * packets of a sensor without a fixed sample size, e.g. the combined
+     * channel */
+    if ((size == packet_size && subscription->fill == 0) || sample_size == 0)
+    {
+        protocol_send_packet(channel, data, size, timestamp);
+        return;
+    }
+
+    while (size > 0)
+    {
+        size_t length = packet_size - subscription->fill;
+        if (length > size)
+        {
+            length = size;
+        }
+
+        /* Capture time of the last sample of this part of the data */
+        size_t samples_after = (size - length) / sample_size;
+        uint32_t time = timestamp - (uint32_t)((uint64_t)samples_after * 1000000u / subscription->rate);
+
+        if (subscription->fill == 0 && length == packet_size)
+        {
+            /* A whole packet; send it without copying */
+            protocol_send_packet(channel, data, length, time);
+        }
+        else if (sensor->batch_buffer != NULL)
+        {
+            /* Collect samples until the packet is full */
+            memcpy(sensor->batch_buffer + subscription->fill, data, length);
+            subscription->fill += length;
+            if (subscription->fill == packet_size)
+            {
+                protocol_send_packet(channel, sensor->batch_buffer, packet_size, time);
+                subscription->fill = 0;
+            }
+        }
+        data += length;
+        size -= length;
+    }
+}
+
+/*******************************************************************************
+* Function Name: protocol_is_subscribed
+********************************************************************************
+* Summary:
+*  Returns true if the host subscribed to the channel, so the sensor data
+*  of the channel needs to be read.
+*
+*******************************************************************************/
+bool protocol_is_subscribed(uint8_t channel)
+{
+    return subscriptions[channel].active;
+}
+
+/*******************************************************************************
+* Function Name: protocol_is_raw
+********************************************************************************
+* Summary:
+*  Returns true if the host subscribed to the unscaled readings of the
+*  sensor on the channel; the sensor data then has to be passed to
+*  protocol_send() in the raw datatype of the sensor.
+*
+*******************************************************************************/
+bool protocol_is_raw(uint8_t channel)
+{
+    const sensor_t* sensor = sensor_find(channel);
+    return subscriptions[channel].active && sensor != NULL &&
+           subscriptions[channel].datatype == sensor->raw_datatype;
+}
+
+/*******************************************************************************
+* Function Name: protocol_send_packet
+********************************************************************************
+* Summary:
+*  Sends one packet of a subscribed channel, or holds it in the backlog if
+*  the channel is under flow control and has no credit for it.
+*
+*******************************************************************************/
+static void protocol_send_packet(uint8_t channel, const uint8_t* data, size_t size, uint32_t timestamp)
+{
+    /* The packet is numbered now, so packets dropped from the backlog show
+     * as a gap in the sequence numbers. Sent or not, it is kept for resend
+     * requests. */
+    uint16_t number = sequence[channel]++;
+    if (framing == FRAMING_V2 || framing == FRAMING_COBS)
+    {
+        const packet_ring_entry_t packet = { .size = (uint16_t)size, .sequence = number, .timestamp = timestamp };
+        history_put(channel, &packet, data);
+    }
+
+    if (credit_is_enabled(channel))
+    {
+        /* Packets leave the backlog in order, before this one */
+        packet_ring_entry_t oldest;
+        protocol_send_backlog(channel);
+        if (credit_peek(channel, &oldest) != NULL || !protocol_take_credit(channel, size))
+        {
+            const packet_ring_entry_t packet = { .size = (uint16_t)size, .sequence = number, .timestamp = timestamp };
+            credit_queue(channel, &packet, data);
+            return;
+        }
+    }
+    protocol_send_numbered(channel, number, data, size, timestamp);
+}
+
+/*******************************************************************************
+* Function Name: protocol_send_numbered
+********************************************************************************
+* Summary:
+*  Sends one packet with the given sequence number, or queues it in the
+*  scheduler if the channel is scheduled, unless the link is down or
+*  backpressure drops it.
+*
+*******************************************************************************/
+static void protocol_send_numbered(uint8_t channel, uint16_t number, const uint8_t* data, size_t size, uint32_t timestamp)
+{
+    /* Streams pause while the link is down. Under backpressure, whole
+     * packets are dropped rather than waiting for the link; the sequence
+     * number also counts dropped packets, so the host can tell where data
+     * is missing. */
+    if (!streaming_is_connected() || !backpressure_admit(channel, protocol_frame_size(size)))
+    {
+        return;
+    }
+
+    if (protocol_is_scheduled(channel))
+    {
+        const packet_ring_entry_t packet = { .size = (uint16_t)size, .sequence = number, .timestamp = timestamp };
+        scheduler_enqueue(channel, &packet, data);
+        protocol_send_scheduled();
+    }
+    else
+    {
+        protocol_send_frame_numbered(channel, number, 0, 0, data, size, timestamp);
+    }
+}
+
+/*******************************************************************************
+* Function Name: protocol_send_backlog
+********************************************************************************
+* Summary:
+*  Sends the packets in the backlog of a channel, oldest first, while the
+*  channel has credit for them. Packets stay in the backlog while the link
+*  is congested, until protocol_repl() finds room for them.
+*
+*******************************************************************************/
+static void protocol_send_backlog(uint8_t channel)
+{
+    packet_ring_entry_t packet;
+    const uint8_t* data;
+    while ((data = credit_peek(channel, &packet)) != NULL && protocol_take_credit(channel, packet.size))
+    {
+        protocol_send_numbered(channel, packet.sequence, data, packet.size, packet.timestamp);
+        credit_pop(channel);
+    }
+}
+
+/*******************************************************************************
+* Function Name: protocol_take_credit
+********************************************************************************
+* Summary:
+*  Takes the credit for a packet of a channel under flow control, if the
+*  channel has enough and the link can take the packet now. A channel under
+*  flow control is not degraded by backpressure; its packets wait in the
+*  backlog instead.
+*
+* Parameters:
+*  channel: the channel
+*  size: payload size of the packet
+*
+* Return:
+*  True if the packet may be sent.
+*
+*******************************************************************************/
+static bool protocol_take_credit(uint8_t channel, size_t size)
+{
+    size_t frame_size = protocol_frame_size(size);
+
+    if (protocol_is_scheduled(channel))
+    {
+        /* The packet waits in the queue of the scheduler instead */
+        if (!scheduler_has_room(channel, size))
+        {
+            return false;
+        }
+    }
+    else if (streaming_is_congested() || streaming_get_free(channel) < frame_size)
+    {
+        return false;
+    }
+    return credit_take(channel, frame_size);
+}
+
+/*******************************************************************************
+* Function Name: protocol_is_scheduled
+********************************************************************************
+* Summary:
+*  Returns true if the packets of the channel go through the scheduler,
+*  which takes the v2 or cobs framing to mark fragments.
+*
+*******************************************************************************/
+static bool protocol_is_scheduled(uint8_t channel)
+{
+    return (framing == FRAMING_V2 || framing == FRAMING_COBS) && scheduler_is_scheduled(channel);
+}
+
+/*******************************************************************************
+* Function Name: protocol_send_scheduled
+********************************************************************************
+* Summary:
+*  Moves fragments from the queues of the scheduler to the transport, in
+*  the order the scheduler picks them, while the transmit queue of the
+*  transport holds less than SCHEDULER_LINK_DEPTH bytes.
+*
+*******************************************************************************/
+static void protocol_send_scheduled(void)
+{
+    scheduler_fragment_t fragment;
+    streaming_stats_t link;
+
+    while (streaming_is_connected() && scheduler_next(fragment_size, &fragment))
+    {
+        size_t frame_size = protocol_frame_size(fragment.size);
+        streaming_get_stats(&link);
+        if ((link.capacity != 0 && link.queued >= SCHEDULER_LINK_DEPTH) ||
+            streaming_get_free(fragment.channel) < frame_size)
+        {
+            return;
+        }
+        protocol_send_frame_numbered(fragment.channel, fragment.sequence,
+                                     fragment.more ? PROTOCOL_V2_FLAG_MORE_FRAGMENTS : 0,
+                                     fragment.index, fragment.data, fragment.size, fragment.timestamp);
+        scheduler_advance(&fragment);
+    }
+}
+
+/*******************************************************************************
+* Function Name: protocol_frame_size
+********************************************************************************
+* Summary:
+*  Returns the size of a packet on the link in the current framing.
+*
+* Parameters:
+*  size: payload size of the packet
+*
+* Return:
+*  The payload size plus the framing overhead; for COBS, the worst case.
+*
+*******************************************************************************/
+size_t protocol_frame_size(size_t size)
+{
+    switch (framing)
+    {
+    case FRAMING_V2:
+        return PROTOCOL_V2_HEADER_SIZE + size;
+    case FRAMING_COBS:
+        return COBS_MAX_ENCODED_SIZE(PROTOCOL_V2_HEADER_SIZE + size);
+    case FRAMING_ALIGN4:
+        return 4 + ((size + sizeof(CRLF) + 3) & ~(size_t)3);
+    case FRAMING_ALIGN8:
+        return 8 + ((size + sizeof(CRLF) + 7) & ~(size_t)7);
+    default:
+        return 2 + size + sizeof(CRLF);
+    }
+}
+
+/*******************************************************************************
+* Function Name: protocol_send_frame
+********************************************************************************
+* Summary:
+*  Sends a packet of data in the current framing, regardless of
+*  subscriptions and backpressure. The packet is sent as one contiguous
+*  block, on the endpoint of the channel if it has one.
+*
+* Parameters:
+*  channel: the channel to send the packet on, 1-9 in v1 and the aligned
+*           framings and 1-255 in v2 and cobs
+*  data: pointer to data to send, at most PROTOCOL_MAX_PAYLOAD_SIZE bytes
+*  size: number of bytes to send
+*  timestamp: capture time of the data in us
+*
+*******************************************************************************/
+void protocol_send_frame(uint8_t channel, const uint8_t* data, size_t size, uint32_t timestamp)
+{
+    protocol_send_frame_numbered(channel, sequence[channel]++, 0, 0, data, size, timestamp);
+}
+
+/*******************************************************************************
+* Function Name: protocol_send_frame_numbered
+********************************************************************************
+* Summary:
+*  Like protocol_send_frame(), but with the given sequence number and, in
+*  v2 framing, flags (PROTOCOL_V2_FLAG_...) and fragment index.
+*
+*******************************************************************************/
+static void protocol_send_frame_numbered(uint8_t channel, uint16_t number, uint8_t flags, uint8_t index, const uint8_t* data, size_t size, uint32_t timestamp)
+{
+    if (channel > protocol_get_max_channel(framing))
+    {
+        /* The framing has no way to tell the host the channel */
+        return;
+    }
+
+    if (framing == FRAMING_V1)
+    {
+        uint8_t header[2] = { 'B', '0' + channel };
+        const streaming_iovec_t packet[] =
+        {
+            { header, sizeof(header) },
+            { data,   size },
+            { CRLF,   sizeof(CRLF) },
+        };
+        streaming_sendv_channel(channel, packet, sizeof(packet) / sizeof(packet[0]));
+        return;
+    }
+
+    if (framing == FRAMING_ALIGN4 || framing == FRAMING_ALIGN8)
+    {
+        /* The header is padded to the alignment and the payload is padded
+         * before the trailer, so the whole frame is a multiple of the
+         * alignment. A payload in a frame that starts aligned in the host's
+         * receive buffer is then aligned, and so is the next frame. */
+        size_t alignment = framing == FRAMING_ALIGN4 ? 4 : 8;
+        uint8_t header[8] = { 'B', '0' + channel };
+        protocol_put_u16(header + 2, (uint16_t)size);
+        const streaming_iovec_t packet[] =
+        {
+            { header,  alignment },
+            { data,    size },
+            { PADDING, protocol_frame_size(size) - alignment - size - sizeof(CRLF) },
+            { CRLF,    sizeof(CRLF) },
+        };
+        streaming_sendv_channel(channel, packet, sizeof(packet) / sizeof(packet[0]));
+        return;
+    }
+
+    uint8_t header[PROTOCOL_V2_HEADER_SIZE];
+    header[0] = PROTOCOL_V2_MAGIC;
+    header[1] = channel;
+    protocol_put_u16(header + 2, (uint16_t)size);
+    protocol_put_u16(header + 4, number);
+    header[6] = flags;
+    header[7] = index;
+    protocol_put_u32(header + 8, timestamp);
+
+    /* The CRC covers the header up to the CRC field and the payload */
+    crc_start();
+    crc_update(header, 12);
+    crc_update(data, size);
+    protocol_put_u32(header + 12, crc_finish());
+
+    if (framing == FRAMING_COBS)
+    {
+        /* The v2 frame is encoded, so it contains no zero byte, and ends
+         * with a zero byte */
+        if (size > PROTOCOL_MAX_PAYLOAD_SIZE)
+        {
+            return;
+        }
+        cobs_encoder_t encoder;
+        cobs_begin(&encoder, frame_buffer);
+        cobs_update(&encoder, header, sizeof(header));
+        cobs_update(&encoder, data, size);
+        const streaming_iovec_t packet[] =
+        {
+            { frame_buffer, cobs_end(&encoder) },
+        };
+        streaming_sendv_channel(channel, packet, 1);
+    }
+    else
+    {
+        const streaming_iovec_t packet[] =
+        {
+            { header, sizeof(header) },
+            { data,   size },
+        };
+        streaming_sendv_channel(channel, packet, sizeof(packet) / sizeof(packet[0]));
+    }
+}
+
+/*******************************************************************************
+* Function Name: protocol_send_text
+********************************************************************************
+* Summary:
+*  Sends a text response. With COBS framing, the text is sent as a frame of
+*  its own, so the host finds it by the delimiter like any other packet;
+*  text longer than MAX_TEXT_SIZE is truncated rather than sent unencoded.
+*
+* Parameters:
+*  text: the response, including the trailing \r\n
+*
+*******************************************************************************/
+void protocol_send_text(const char* text)
+{
+    size_t size = strlen(text);
+    if (framing == FRAMING_COBS)
+    {
+        if (size > MAX_TEXT_SIZE)
+        {
+            size = MAX_TEXT_SIZE;
+        }
+        cobs_encoder_t encoder;
+        cobs_begin(&encoder, frame_buffer);
+        cobs_update(&encoder, text, size);
+        streaming_send(frame_buffer, cobs_end(&encoder));
+    }
+    else
+    {
+        streaming_send(text, size);
+    }
+}
+
+/*******************************************************************************
+* Function Name: protocol_put_u16
+********************************************************************************
+* Summary:
+*  Stores a 16-bit value in little endian byte order.
+*
+*******************************************************************************/
+static void protocol_put_u16(uint8_t* p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+/*******************************************************************************
+* Function Name: protocol_put_u32
+********************************************************************************
+* Summary:
+*  Stores a 32-bit value in little endian byte order.
+*
+*******************************************************************************/
+static void protocol_put_u32(uint8_t* p, uint32_t value)
+{
+    protocol_put_u16(p, (uint16_t)value);
+    protocol_put_u16(p + 2, (uint16_t)(value >> 16));
 }
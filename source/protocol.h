@@ -37,15 +37,75 @@
 #ifndef SOURCE_PROTOCOL_H_
 #define SOURCE_PROTOCOL_H_
 
-#include "cy_utils.h"
+#include <stdint.h>
 #include "stdlib.h"
 #include "streaming.h"
 
 #define PROTOCOL_AUDIO_CHANNEL 1
 #define PROTOCOL_IMU_CHANNEL 2
+#define PROTOCOL_MUX_CHANNEL 3
+#define PROTOCOL_BENCH_CHANNEL 9
+#define PROTOCOL_GYRO_CHANNEL 10
+
+/* v1 and the aligned framings send the channel as an ASCII digit, v2 and
+ * cobs as a byte */
+#define PROTOCOL_MAX_V1_CHANNEL 9
+#define PROTOCOL_MAX_CHANNEL 255
+
+/* Binary (v2) frame header, see PROTOCOL.md */
+#define PROTOCOL_V2_MAGIC 0xB2
+#define PROTOCOL_V2_HEADER_SIZE 16
+#define PROTOCOL_V2_FLAG_RETRANSMIT 0x01
+#define PROTOCOL_V2_FLAG_MORE_FRAGMENTS 0x02
+
+/* Control messages of a version 2 session are v2 frames on channel 0 whose
+ * payload is a list of items: type (u8), length (u16) and value, see
+ * PROTOCOL.md */
+#define PROTOCOL_CONTROL_CHANNEL 0
+
+/* Items of a request: the command code, then one item per argument */
+#define PROTOCOL_TLV_COMMAND 0x01
+#define PROTOCOL_TLV_UINT 0x02
+#define PROTOCOL_TLV_STRING 0x03
+
+/* Items of a response or notification */
+#define PROTOCOL_TLV_REQUEST 0x10
+#define PROTOCOL_TLV_STATUS 0x11
+#define PROTOCOL_TLV_NOTIFICATION 0x12
+
+/* Items of the config? response; each sensor item holds sensor fields */
+#define PROTOCOL_TLV_DEVICE_NAME 0x20
+#define PROTOCOL_TLV_HEARTBEAT_TIMEOUT 0x21
+#define PROTOCOL_TLV_SENSOR 0x22
+#define PROTOCOL_TLV_CHANNEL 0x30
+#define PROTOCOL_TLV_TYPE 0x31
+#define PROTOCOL_TLV_DATATYPE 0x32
+#define PROTOCOL_TLV_SHAPE 0x33
+#define PROTOCOL_TLV_RATES 0x34
+#define PROTOCOL_TLV_BATCH_SIZES 0x35
+#define PROTOCOL_TLV_RAW_DATATYPE 0x36
+#define PROTOCOL_TLV_SCALE 0x37
+#define PROTOCOL_TLV_ENDPOINT 0x38
+
+/* Items of the stats? response */
+#define PROTOCOL_TLV_LINK_STATS 0x40
+#define PROTOCOL_TLV_CHANNEL_STATS 0x41
+#define PROTOCOL_TLV_USB_AUDIO_STATS 0x42
+
+/* Events of notification items */
+#define PROTOCOL_EVENT_STREAMING_STOPPED 1
+
+/* Largest packet payload with COBS framing; an audio frame with the IMU
+ * samples of the combined channel */
+#define PROTOCOL_MAX_PAYLOAD_SIZE 2560
 
 void protocol_init();
 void protocol_repl();
-void protocol_send(uint8_t channel, const uint8_t* data, size_t count);
+void protocol_send(uint8_t channel, const uint8_t* data, size_t count, uint32_t timestamp);
+bool protocol_is_raw(uint8_t channel);
+bool protocol_is_subscribed(uint8_t channel);
+void protocol_send_frame(uint8_t channel, const uint8_t* data, size_t count, uint32_t timestamp);
+void protocol_send_text(const char* text);
+size_t protocol_frame_size(size_t count);
 
 #endif /* SOURCE_PROTOCOL_H_ */
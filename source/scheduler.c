@@ -0,0 +1,399 @@
+/******************************************************************************
+* File Name:   scheduler.c
+*
+* Description: This file contains the transmit scheduler: a queue per channel,
+*              served in weighted deficit round-robin order, with large packets
+*              cut into fragments.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#include <string.h>
+#include "clock.h"
+#include "config.h"
+#include "scheduler.h"
+
+/* TRANSMIT SCHEDULER
+ * ==================
+ * Without a scheduler, packets enter the transmit queue of the transport in
+ * the order the main loop produces them, so an IMU packet waits behind every
+ * audio frame queued before it. With the v2 and cobs framings, packets of
+ * the channels in SCHEDULER_CHANNELS first go to a queue of their own. The
+ * protocol moves data from these queues to the transport only while the
+ * transport holds less than SCHEDULER_LINK_DEPTH bytes, and asks
+ * scheduler_next() which piece goes next.
+ *
+ * The queues are served with deficit round-robin: on its turn, a channel
+ * gets its quantum of bytes added to its deficit and sends fragments while
+ * the deficit covers them; an idle channel keeps no deficit. Each channel
+ * thus gets bandwidth in proportion to its quantum, and a small packet waits
+ * for at most one round of the other channels. With a fragment size set,
+ * packets are cut into fragments of at most that size, so a round is short
+ * even with whole audio frames queued. */
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define SCHEDULER_LATENCY_WEIGHT    (8)
+/* The average latency moves by 1/8 of the difference to each new sample */
+#define SCHEDULER_QUEUE_PACKETS     (64u)
+/* Most packets in a queue; each has its queuing time kept beside the ring */
+
+
+/*******************************************************************************
+* Local Type Declarations
+*******************************************************************************/
+/* The queue of one channel */
+typedef struct
+{
+    packet_ring_t     packets;
+    size_t            offset;       /* Bytes of the oldest packet already sent */
+    uint8_t           index;        /* Its next fragment number */
+    uint32_t          deficit;
+    scheduler_stats_t stats;
+    uint32_t          buffer[SCHEDULER_QUEUE_SIZE / sizeof(uint32_t)];
+    /* Time in us each packet was queued, from the oldest at queued_tail,
+     * so that the ring entries shared with the history and the credit
+     * backlogs need not carry it */
+    uint32_t          queued[SCHEDULER_QUEUE_PACKETS];
+    size_t            queued_tail;
+} scheduler_queue_t;
+
+
+/*******************************************************************************
+* Local Constants
+*******************************************************************************/
+static const uint8_t SCHEDULER_CHANNEL_LIST[] = SCHEDULER_CHANNELS;
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+static scheduler_queue_t queues[sizeof(SCHEDULER_CHANNEL_LIST)];
+static size_t current = 0;
+
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static scheduler_queue_t* scheduler_find(uint8_t channel);
+static void scheduler_next_queue(void);
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: scheduler_init
+********************************************************************************
+* Summary:
+*  Initializes the queues. Call this once before using any other function
+*  in this file.
+*
+*******************************************************************************/
+void scheduler_init(void)
+{
+    for (size_t i = 0; i < sizeof(queues) / sizeof(queues[0]); i++)
+    {
+        packet_ring_init(&queues[i].packets, queues[i].buffer, sizeof(queues[i].buffer));
+        queues[i].stats.quantum = SCHEDULER_DEFAULT_QUANTUM;
+    }
+    scheduler_clear();
+}
+
+/*******************************************************************************
+* Function Name: scheduler_is_scheduled
+********************************************************************************
+* Summary:
+*  Returns true if the channel has a queue.
+*
+*******************************************************************************/
+bool scheduler_is_scheduled(uint8_t channel)
+{
+    return scheduler_find(channel) != NULL;
+}
+
+/*******************************************************************************
+* Function Name: scheduler_has_room
+********************************************************************************
+* Summary:
+*  Returns true if a packet with a payload of size bytes fits in the queue
+*  of the channel.
+*
+*******************************************************************************/
+bool scheduler_has_room(uint8_t channel, size_t size)
+{
+    const scheduler_queue_t* queue = scheduler_find(channel);
+    return queue != NULL && queue->packets.count < SCHEDULER_QUEUE_PACKETS &&
+           packet_ring_has_room(&queue->packets, size);
+}
+
+/*******************************************************************************
+* Function Name: scheduler_enqueue
+********************************************************************************
+* Summary:
+*  Adds a packet to the queue of its channel. If the queue is full, the new
+*  packet is dropped; the packets in the queue, of which the oldest may be
+*  partly sent, are kept.
+*
+* Parameters:
+*  channel: the channel, which must have a queue
+*  packet: size, sequence number and timestamp of the packet
+*  data: the payload
+*
+* Return:
+*  False if the packet was dropped.
+*
+*******************************************************************************/
+bool scheduler_enqueue(uint8_t channel, const packet_ring_entry_t* packet, const uint8_t* data)
+{
+    scheduler_queue_t* queue = scheduler_find(channel);
+    if (queue == NULL)
+    {
+        return false;
+    }
+    if (queue->packets.count == SCHEDULER_QUEUE_PACKETS ||
+        !packet_ring_has_room(&queue->packets, packet->size))
+    {
+        queue->stats.dropped++;
+        return false;
+    }
+
+    queue->queued[(queue->queued_tail + queue->packets.count) % SCHEDULER_QUEUE_PACKETS] = clock_now_us();
+    packet_ring_put(&queue->packets, packet, data);
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: scheduler_next
+********************************************************************************
+* Summary:
+*  Picks the next fragment to send. The fragment stays in its queue until
+*  it is passed to scheduler_advance(), so the caller may leave it for
+*  later, e.g. if the link has no room for it.
+*
+* Parameters:
+*  fragment_size: largest fragment, or 0 to send whole packets
+*  fragment: pointer to where the fragment is stored
+*
+* Return:
+*  False if all queues are empty.
+*
+*******************************************************************************/
+bool scheduler_next(size_t fragment_size, scheduler_fragment_t* fragment)
+{
+    bool pending = false;
+    for (size_t i = 0; i < sizeof(queues) / sizeof(queues[0]); i++)
+    {
+        pending = pending || queues[i].packets.count > 0;
+    }
+
+    /* Each turn adds at least SCHEDULER_MIN_QUANTUM to a waiting queue, so
+     * this ends after a few rounds */
+    while (pending)
+    {
+        scheduler_queue_t* queue = &queues[current];
+        packet_ring_entry_t packet;
+        const uint8_t* data = packet_ring_peek(&queue->packets, &packet);
+        if (data == NULL)
+        {
+            queue->deficit = 0;
+            scheduler_next_queue();
+            continue;
+        }
+
+        size_t size = packet.size - queue->offset;
+        if (fragment_size != 0 && size > fragment_size)
+        {
+            size = fragment_size;
+        }
+        if (size <= queue->deficit)
+        {
+            fragment->channel = SCHEDULER_CHANNEL_LIST[current];
+            fragment->index = queue->index;
+            fragment->more = queue->offset + size < packet.size;
+            fragment->sequence = packet.sequence;
+            fragment->timestamp = packet.timestamp;
+            fragment->data = data + queue->offset;
+            fragment->size = size;
+            return true;
+        }
+        scheduler_next_queue();
+    }
+    return false;
+}
+
+/*******************************************************************************
+* Function Name: scheduler_advance
+********************************************************************************
+* Summary:
+*  Removes a fragment returned by scheduler_next() from its queue after it
+*  has been sent. After the last fragment of a packet, its queue latency is
+*  counted.
+*
+*******************************************************************************/
+void scheduler_advance(const scheduler_fragment_t* fragment)
+{
+    scheduler_queue_t* queue = scheduler_find(fragment->channel);
+    packet_ring_entry_t packet;
+    if (queue == NULL || packet_ring_peek(&queue->packets, &packet) == NULL)
+    {
+        return;
+    }
+
+    queue->deficit -= (uint32_t)fragment->size;
+    queue->offset += fragment->size;
+    queue->index++;
+    if (!fragment->more)
+    {
+        uint32_t latency = clock_now_us() - queue->queued[queue->queued_tail];
+        int32_t difference = (int32_t)(latency - queue->stats.latency_us);
+        queue->stats.latency_us += difference / SCHEDULER_LATENCY_WEIGHT;
+        if (latency > queue->stats.latency_max_us)
+        {
+            queue->stats.latency_max_us = latency;
+        }
+
+        packet_ring_pop(&queue->packets);
+        queue->queued_tail = (queue->queued_tail + 1) % SCHEDULER_QUEUE_PACKETS;
+        queue->offset = 0;
+        queue->index = 0;
+    }
+}
+
+/*******************************************************************************
+* Function Name: scheduler_set_quantum
+********************************************************************************
+* Summary:
+*  Sets the bytes a channel may send per round, and so its share of the
+*  bandwidth while several channels have data waiting.
+*
+* Return:
+*  False if the channel has no queue or the quantum is too small.
+*
+*******************************************************************************/
+bool scheduler_set_quantum(uint8_t channel, uint32_t quantum)
+{
+    scheduler_queue_t* queue = scheduler_find(channel);
+    if (queue == NULL || quantum < SCHEDULER_MIN_QUANTUM)
+    {
+        return false;
+    }
+    queue->stats.quantum = quantum;
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: scheduler_clear
+********************************************************************************
+* Summary:
+*  Empties all queues, e.g. when the framing changes.
+*
+*******************************************************************************/
+void scheduler_clear(void)
+{
+    for (size_t i = 0; i < sizeof(queues) / sizeof(queues[0]); i++)
+    {
+        packet_ring_clear(&queues[i].packets);
+        queues[i].queued_tail = 0;
+        queues[i].offset = 0;
+        queues[i].index = 0;
+        queues[i].deficit = 0;
+    }
+}
+
+/*******************************************************************************
+* Function Name: scheduler_get_stats
+********************************************************************************
+* Summary:
+*  Returns the queue state of a channel; all zero if it has no queue.
+*
+* Parameters:
+*  channel: the channel
+*  stats: pointer to where the state will be stored
+*
+*******************************************************************************/
+void scheduler_get_stats(uint8_t channel, scheduler_stats_t* stats)
+{
+    const scheduler_queue_t* queue = scheduler_find(channel);
+    if (queue != NULL)
+    {
+        *stats = queue->stats;
+        stats->queued = queue->packets.count;
+    }
+    else
+    {
+        memset(stats, 0, sizeof(*stats));
+    }
+}
+
+/*******************************************************************************
+* Function Name: scheduler_find
+********************************************************************************
+* Summary:
+*  Returns the queue of a channel, or NULL if it has none.
+*
+*******************************************************************************/
+static scheduler_queue_t* scheduler_find(uint8_t channel)
+{
+    for (size_t i = 0; i < sizeof(SCHEDULER_CHANNEL_LIST); i++)
+    {
+        if (SCHEDULER_CHANNEL_LIST[i] == channel)
+        {
+            return &queues[i];
+        }
+    }
+    return NULL;
+}
+
+/*******************************************************************************
+* Function Name: scheduler_next_queue
+********************************************************************************
+* Summary:
+*  Passes the turn to the next queue, which gets its quantum if it has data
+*  waiting.
+*
+*******************************************************************************/
+static void scheduler_next_queue(void)
+{
+    current = (current + 1) % (sizeof(queues) / sizeof(queues[0]));
+    if (queues[current].packets.count > 0)
+    {
+        queues[current].deficit += queues[current].stats.quantum;
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,94 @@
+/******************************************************************************
+* File Name:   scheduler.h
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#ifndef SOURCE_SCHEDULER_H_
+#define SOURCE_SCHEDULER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "packet_ring.h"
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define SCHEDULER_DEFAULT_QUANTUM   (512u)
+/* Bytes a channel may send per round unless the host sets its weight */
+#define SCHEDULER_MIN_QUANTUM       (64u)
+/* Smallest quantum the host may set */
+
+/*******************************************************************************
+* Type Definitions
+*******************************************************************************/
+/* The next piece of a queued packet to send */
+typedef struct
+{
+    uint8_t        channel;
+    uint8_t        index;       /* Fragment number within the packet, from 0 */
+    bool           more;        /* More fragments of the packet follow */
+    uint16_t       sequence;    /* Of the whole packet */
+    uint32_t       timestamp;   /* Of the whole packet */
+    const uint8_t* data;
+    size_t         size;
+} scheduler_fragment_t;
+
+/* Queue state of one channel */
+typedef struct
+{
+    uint32_t quantum;           /* Bytes per round */
+    uint32_t queued;            /* Packets waiting */
+    uint32_t dropped;           /* Packets dropped because the queue was full */
+    uint32_t latency_us;        /* Average time from queuing to the last fragment */
+    uint32_t latency_max_us;    /* Longest such time */
+} scheduler_stats_t;
+
+/*******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+void scheduler_init(void);
+bool scheduler_is_scheduled(uint8_t channel);
+bool scheduler_has_room(uint8_t channel, size_t size);
+bool scheduler_enqueue(uint8_t channel, const packet_ring_entry_t* packet, const uint8_t* data);
+bool scheduler_next(size_t fragment_size, scheduler_fragment_t* fragment);
+void scheduler_advance(const scheduler_fragment_t* fragment);
+bool scheduler_set_quantum(uint8_t channel, uint32_t quantum);
+void scheduler_clear(void);
+void scheduler_get_stats(uint8_t channel, scheduler_stats_t* stats);
+
+#endif /* SOURCE_SCHEDULER_H_ */
+
+/* [] END OF FILE */
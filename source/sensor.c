@@ -0,0 +1,200 @@
+/******************************************************************************
+* File Name:   sensor.c
+*
+* Description: This file keeps the registry of sensors. Each sensor module
+*              registers its channel and capabilities, and the protocol advertises
+*              and checks subscriptions against them.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#include <stdlib.h>
+#include "sensor.h"
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+static const sensor_t* sensors[SENSOR_MAX_SENSORS];
+static size_t sensor_count = 0;
+static uint32_t sensor_generation = 0;
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: sensor_register
+********************************************************************************
+* Summary:
+*  Adds a sensor to the registry. Sensors are advertised in the order they
+*  are registered.
+*
+* Parameters:
+*  sensor: the sensor; must stay valid, as only the pointer is stored
+*
+* Return:
+*  False if the registry is full or the channel is taken.
+*
+*******************************************************************************/
+bool sensor_register(const sensor_t* sensor)
+{
+    if (sensor_count == SENSOR_MAX_SENSORS || sensor_find(sensor->channel) != NULL)
+    {
+        return false;
+    }
+    sensors[sensor_count++] = sensor;
+    sensor_generation++;
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: sensor_find
+********************************************************************************
+* Summary:
+*  Looks up the sensor on a channel.
+*
+* Return:
+*  The sensor, or NULL if no sensor uses the channel.
+*
+*******************************************************************************/
+const sensor_t* sensor_find(uint32_t channel)
+{
+    for (size_t i = 0; i < sensor_count; i++)
+    {
+        if (sensors[i]->channel == channel)
+        {
+            return sensors[i];
+        }
+    }
+    return NULL;
+}
+
+/*******************************************************************************
+* Function Name: sensor_get
+********************************************************************************
+* Summary:
+*  Returns a sensor by its index in the registry, to iterate over all.
+*
+* Return:
+*  The sensor, or NULL if index is past the last sensor.
+*
+*******************************************************************************/
+const sensor_t* sensor_get(size_t index)
+{
+    return index < sensor_count ? sensors[index] : NULL;
+}
+
+/*******************************************************************************
+* Function Name: sensor_get_sample_size
+********************************************************************************
+* Summary:
+*  Returns the size of one sample of the sensor in bytes, or 0 if the
+*  datatype has no fixed size, e.g. "mux".
+*
+* Parameters:
+*  sensor: the sensor
+*  datatype: the datatype of the sample, datatype or raw_datatype
+*
+*******************************************************************************/
+size_t sensor_get_sample_size(const sensor_t* sensor, const char* datatype)
+{
+    /* A numeric datatype ends in its size in bits, e.g. "s16" */
+    size_t element_size = (size_t)atoi(datatype + 1) / 8;
+    return element_size * sensor->features;
+}
+
+/*******************************************************************************
+* Function Name: sensor_supports_rate
+********************************************************************************
+* Summary:
+*  Checks if the rate is one of the rates of the sensor.
+*
+*******************************************************************************/
+bool sensor_supports_rate(const sensor_t* sensor, uint32_t rate)
+{
+    for (size_t i = 0; i < sensor->rate_count; i++)
+    {
+        if (sensor->rates[i] == rate)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*******************************************************************************
+* Function Name: sensor_supports_batch_size
+********************************************************************************
+* Summary:
+*  Checks if the host may ask for packets of the given number of samples.
+*  Without a list of batch sizes, only the samples of the shape are allowed.
+*  Batches that do not evenly divide the samples need a batch buffer.
+*
+*******************************************************************************/
+bool sensor_supports_batch_size(const sensor_t* sensor, uint32_t samples)
+{
+    if (samples == 0 || (sensor->batch_buffer == NULL && sensor->samples % samples != 0))
+    {
+        return false;
+    }
+    if (sensor->batch_size_count == 0)
+    {
+        return samples == sensor->samples;
+    }
+    for (size_t i = 0; i < sensor->batch_size_count; i++)
+    {
+        if (sensor->batch_sizes[i] == samples)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*******************************************************************************
+* Function Name: sensor_get_generation
+********************************************************************************
+* Summary:
+*  Returns a number that changes whenever a sensor is registered, so that
+*  information derived from the registry can be cached.
+*
+*******************************************************************************/
+uint32_t sensor_get_generation(void)
+{
+    return sensor_generation;
+}
+
+/* [] END OF FILE */
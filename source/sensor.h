@@ -0,0 +1,90 @@
+/******************************************************************************
+* File Name:   sensor.h
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#ifndef SOURCE_SENSOR_H_
+#define SOURCE_SENSOR_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define SENSOR_MAX_SENSORS          (8u)
+/* Most sensors that can be registered */
+
+/*******************************************************************************
+* Type Definitions
+*******************************************************************************/
+/* A sensor, or a channel derived from one, as advertised to the host.
+ * Besides datatype, a sensor may offer its unscaled readings as
+ * raw_datatype, which the host converts by multiplying with raw_scale.
+ * samples is the number of samples the sensor passes to protocol_send() at
+ * once and the default number of samples per packet. If batches do not
+ * evenly divide samples, the sensor provides a batch buffer with room for
+ * its largest batch. */
+typedef struct
+{
+    uint8_t         channel;        /* Channel of its data packets */
+    const char*     type;           /* Sensor type name, e.g. "microphone" */
+    const char*     datatype;       /* Element type: "s16", "f32", ... */
+    uint16_t        samples;        /* Shape of the data: samples... */
+    uint16_t        features;       /* ...by features per sample */
+    const uint32_t* rates;          /* Supported rates in Hz */
+    size_t          rate_count;
+    const uint16_t* batch_sizes;    /* Samples per packet the host may choose */
+    size_t          batch_size_count;
+    uint8_t*        batch_buffer;   /* Collects samples of a batch, or NULL */
+    const char*     raw_datatype;   /* Type of the unscaled readings, or NULL */
+    float           raw_scale;      /* Value of one raw unit in datatype */
+} sensor_t;
+
+/*******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+bool sensor_register(const sensor_t* sensor);
+const sensor_t* sensor_find(uint32_t channel);
+const sensor_t* sensor_get(size_t index);
+size_t sensor_get_sample_size(const sensor_t* sensor, const char* datatype);
+bool sensor_supports_rate(const sensor_t* sensor, uint32_t rate);
+bool sensor_supports_batch_size(const sensor_t* sensor, uint32_t samples);
+uint32_t sensor_get_generation(void);
+
+#endif /* SOURCE_SENSOR_H_ */
+
+/* [] END OF FILE */
@@ -2,9 +2,10 @@
 * File Name:   streaming.c
 *
 * Description: This file contains functions for streaming data over a serial
-*              interface. It supports using either USB CDC (default) or UART
-*              over the debug port. See comment below for how to switch to the
-*              debug port UART.
+*              interface. The data is passed on to one of several transport
+*              backends, selected at runtime: USB CDC (default), UART over
+*              the debug port, UDP over Wi-Fi, an in-memory loopback and,
+*              when built on Linux, a file or pseudo-terminal.
 *
 *******************************************************************************
 * Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
@@ -39,101 +40,112 @@
 * so agrees to indemnify Cypress against all liability.
 *******************************************************************************/
 
+#include <string.h>
+#include "config.h"
 #include "streaming.h"
 
-/* SUPPORT FOR USB CDC AND DEBUG UART
- * ==================================
- * This file contains functions for streaming both through the USB CDC and
- * through the debug UART; however streaming through the debug UART is unstable
- * and NOT recommended. It's not clear if the problems happen on the device or
- * on the host PC. Problems we have seen include:
- * - Intermittent large data chunks buffered causing halts and high latency
- * - Dropped bytes, causing byte flips (LSB <=> MSB) and thus distorted data
- * - Triggers a bug in .NET SerialPort, causing complete crash of the Studio
- *
- * If this didn't scare you and you still want to try it, to enable streaming
- * through debug UART:
- * - Remove USBD_BASE from COMPONENT in the Makefile (will enable the lower
- *   part of this file
- * - Remove the emusb-device library using the Library Manager
- * - Remove the imports folder (remnants from the emusb-device) */
-
-
-/******************************************************************************
-*
-* USB CDC streaming functions
-*
-******************************************************************************/
-
-#ifdef COMPONENT_USBD_BASE
-
-#include "USB.h"
-#include "USB_CDC.h"
+/* TRANSPORT BACKENDS
+ * ==================
+ * Each backend implements the streaming_transport_t interface in its own
+ * file (streaming_usb.c, streaming_uart.c, ...) and is listed in
+ * streaming_transports below. The first available backend is used unless
+ * another one is chosen with streaming_select() before streaming_init().
+ * A new link only needs a new backend; the protocol code does not change. */
 
 
 /*******************************************************************************
-* Local Type Declarations
+* Local Constants
 *******************************************************************************/
-static const USB_DEVICE_INFO usb_deviceInfo = {
-    0x058B,                       /* VendorId    */
-    0x027D,                       /* ProductId    */
-    "Infineon Technologies",      /* VendorName   */
-    "Imagimob Streamer Example",  /* ProductName  */
-    "12345678"                    /* SerialNumber */
+static const streaming_transport_t* const streaming_transports[] =
+{
+#ifdef COMPONENT_USBD_BASE
+    &streaming_usb_transport,
+#endif
+#ifndef __linux__
+    &streaming_uart_transport,
+#endif
+#ifdef __linux__
+    &streaming_file_transport,
+#endif
+#if defined(__linux__) || IM_ENABLE_WIFI
+    &streaming_udp_transport,
+#endif
+    &streaming_loopback_transport,
 };
 
 
 /*******************************************************************************
 * Local Variables
 *******************************************************************************/
-static USB_CDC_HANDLE usb_cdcHandle;
+static const streaming_transport_t* transport = NULL;
+static bool congested = false;
 
 
 /*******************************************************************************
-* Local Function Prototypes
+* Function Definitions
 *******************************************************************************/
-static void streaming_usb_add_cdc(void);
 
+/*******************************************************************************
+* Function Name: streaming_select
+********************************************************************************
+* Summary:
+*  Selects the transport backend by name. Call this before streaming_init().
+*
+* Parameters:
+*  name: name of the backend, e.g. "usb" or "uart"
+*
+* Return:
+*  True if the backend is available; otherwise the selection is unchanged.
+*
+*******************************************************************************/
+bool streaming_select(const char* name)
+{
+    for (size_t i = 0; i < sizeof(streaming_transports) / sizeof(streaming_transports[0]); i++)
+    {
+        if (strcmp(streaming_transports[i]->name, name) == 0)
+        {
+            transport = streaming_transports[i];
+            return true;
+        }
+    }
+    return false;
+}
 
 /*******************************************************************************
-* Function Definitions
+* Function Name: streaming_get_transport
+********************************************************************************
+* Summary:
+*  Returns the selected transport backend.
+*
 *******************************************************************************/
+const streaming_transport_t* streaming_get_transport(void)
+{
+    if (transport == NULL)
+    {
+        transport = streaming_transports[0];
+    }
+    return transport;
+}
 
 /*******************************************************************************
 * Function Name: streaming_init
 ********************************************************************************
 * Summary:
 *  Initializes the streaming interface. Call this once before using any other
-*  function in this file.
+*  function in this file, except streaming_select().
 *
 *******************************************************************************/
 void streaming_init()
 {
-    /* Initializes the USB stack */
-    USBD_Init();
-
-    /* Endpoint Initialization for CDC class */
-    streaming_usb_add_cdc();
-
-    /* Set device info used in enumeration */
-    USBD_SetDeviceInfo(&usb_deviceInfo);
-
-    /* Start the USB stack */
-    USBD_Start();
-
-    /* Wait for the usb to be configured (including connected physically */
-    while ((USBD_GetState() & USB_STAT_CONFIGURED) != USB_STAT_CONFIGURED)
-    {
-        cyhal_system_delay_ms(50U); /* 50ms delay */
-    }
+    streaming_get_transport()->init();
 }
 
 /*******************************************************************************
 * Function Name: streaming_receive
 ********************************************************************************
 * Summary:
-*  Reads bytes from the streaming interface into the given buffer if available.
-*  This function may block for up to 1 ms.
+*  Reads all available bytes from the streaming interface into the given
+*  buffer, up to its size. This function does not block.
 **
 * Parameters:
 *  data: pointer to buffer where data will be stored
@@ -145,20 +157,16 @@ void streaming_init()
 *******************************************************************************/
 size_t streaming_receive(void* data, size_t size)
 {
-    /* Wait for 1 character for up to 1 ms */
-    /* TODO: Enable callback on receive to set a flag, and here, if the flag is
-     * set, use USBD_CDC_Receive() to obtain all available bytes at the same
-     * time. Note that USBD_CDC_GetNumBytesInBuffer() seems to always return 0.
-     */
-    return USBD_CDC_Read(usb_cdcHandle, data, 1, 1);
+    return transport->receive(data, size);
 }
 
 /*******************************************************************************
 * Function Name: streaming_send
 ********************************************************************************
 * Summary:
-*  Sends the given bytes to the streaming interface. This function will block
-*  until transmission is complete.
+*  Queues the given bytes for transmission and returns immediately. The data
+*  is copied, so the caller may reuse its buffer. This function only blocks
+*  if the transmit queue is full.
 *
 * Parameters:
 *  data: pointer to data to send
@@ -167,190 +175,190 @@ size_t streaming_receive(void* data, size_t size)
 *******************************************************************************/
 void streaming_send(const void* data, size_t size)
 {
-    /* Write and block until write is complete */
-    USBD_CDC_Write(usb_cdcHandle, data, size, 0);
-    USBD_CDC_WaitForTX(usb_cdcHandle, 0);
+    transport->send(data, size);
 }
 
 /*******************************************************************************
-* Function Name: streaming_usb_add_cdc
+* Function Name: streaming_sendv
 ********************************************************************************
 * Summary:
-*  Initializes USB CDC.
+*  Queues a list of buffers for transmission as one contiguous block and
+*  returns immediately. The data is copied, so the caller may reuse its
+*  buffers. This function only blocks if the transmit queue is full.
+*
+* Parameters:
+*  iov: array of buffers to send, in order
+*  count: number of elements in iov
 *
 *******************************************************************************/
-static void streaming_usb_add_cdc(void)
+void streaming_sendv(const streaming_iovec_t* iov, size_t count)
 {
-    static U8             OutBuffer[USB_FS_BULK_MAX_PACKET_SIZE];
-    USB_CDC_INIT_DATA     InitData;
-    USB_ADD_EP_INFO       EPBulkIn;
-    USB_ADD_EP_INFO       EPBulkOut;
-    USB_ADD_EP_INFO       EPIntIn;
-
-    memset(&InitData, 0, sizeof(InitData));
-    EPBulkIn.Flags          = 0;                             /* Flags not used */
-    EPBulkIn.InDir          = USB_DIR_IN;                    /* IN direction (Device to Host) */
-    EPBulkIn.Interval       = 0;                             /* Interval not used for Bulk endpoints */
-    EPBulkIn.MaxPacketSize  = USB_FS_BULK_MAX_PACKET_SIZE;   /* Maximum packet size (64B for Bulk in full-speed) */
-    EPBulkIn.TransferType   = USB_TRANSFER_TYPE_BULK;        /* Endpoint type - Bulk */
-    InitData.EPIn  = USBD_AddEPEx(&EPBulkIn, NULL, 0);
-
-    EPBulkOut.Flags         = 0;                             /* Flags not used */
-    EPBulkOut.InDir         = USB_DIR_OUT;                   /* OUT direction (Host to Device) */
-    EPBulkOut.Interval      = 0;                             /* Interval not used for Bulk endpoints */
-    EPBulkOut.MaxPacketSize = USB_FS_BULK_MAX_PACKET_SIZE;   /* Maximum packet size (64B for Bulk in full-speed) */
-    EPBulkOut.TransferType  = USB_TRANSFER_TYPE_BULK;        /* Endpoint type - Bulk */
-    InitData.EPOut = USBD_AddEPEx(&EPBulkOut, OutBuffer, sizeof(OutBuffer));
-
-    EPIntIn.Flags           = 0;                             /* Flags not used */
-    EPIntIn.InDir           = USB_DIR_IN;                    /* IN direction (Device to Host) */
-    EPIntIn.Interval        = 64;                            /* Interval of 8 ms (64 * 125us) */
-    EPIntIn.MaxPacketSize   = USB_FS_INT_MAX_PACKET_SIZE ;   /* Maximum packet size (64 for Interrupt) */
-    EPIntIn.TransferType    = USB_TRANSFER_TYPE_INT;         /* Endpoint type - Interrupt */
-    InitData.EPInt = USBD_AddEPEx(&EPIntIn, NULL, 0);
-
-    usb_cdcHandle = USBD_CDC_Add(&InitData);
+    transport->sendv(iov, count);
 }
 
-
-#else
-
-/******************************************************************************
+/*******************************************************************************
+* Function Name: streaming_sendv_channel
+********************************************************************************
+* Summary:
+*  Like streaming_sendv(), but for data of the given channel. If the
+*  transport has a separate endpoint for the channel, the data is queued
+*  there, so it is not held up by data of other channels. Otherwise it is
+*  sent with streaming_sendv().
 *
-* Debug UART streaming functions
+* Parameters:
+*  channel: the channel the data belongs to
+*  iov: array of buffers to send, in order
+*  count: number of elements in iov
 *
-******************************************************************************/
-
-#include "cybsp.h"
-#include "cyhal_uart.h"
-
-
-/*******************************************************************************
-* Macros
 *******************************************************************************/
-#define UART_BAUD_RATE              (1000000u)
-/* NOTE: The debug UART may not support standard baud rates like 921600 due to
- * its clock configuration, so consider this before changing. It should work
- * well with 500000 and 1000000. I'm not sure why, but possibly because it's
- * based on the 32 MHz MPU clock, so there's no integer divider for e.g.
- * 921600. */
-#define RX_BUF_SIZE                 (32u)
-/* Should be enough for a complete protocol command. */
+void streaming_sendv_channel(uint8_t channel, const streaming_iovec_t* iov, size_t count)
+{
+    if (transport->sendv_channel == NULL || !transport->sendv_channel(channel, iov, count))
+    {
+        transport->sendv(iov, count);
+    }
+}
 
 /*******************************************************************************
-* Local Variables
+* Function Name: streaming_get_channel_endpoint
+********************************************************************************
+* Summary:
+*  Returns the address of the endpoint that carries the given channel.
+*
+* Parameters:
+*  channel: the channel
+*
+* Return:
+*  The endpoint address, or 0 if the channel shares the main link.
+*
 *******************************************************************************/
-static cyhal_uart_t  uart_obj;
-static uint8_t       uart_rx_buffer[RX_BUF_SIZE];
-static volatile bool uart_busy = false;
-
+uint8_t streaming_get_channel_endpoint(uint8_t channel)
+{
+    if (streaming_get_transport()->get_channel_endpoint == NULL)
+    {
+        return 0;
+    }
+    return transport->get_channel_endpoint(channel);
+}
 
 /*******************************************************************************
-* Function Definitions
+* Function Name: streaming_flush
+********************************************************************************
+* Summary:
+*  Blocks until all queued data has been transmitted.
+*
 *******************************************************************************/
+void streaming_flush(void)
+{
+    transport->flush();
+}
 
 /*******************************************************************************
-* Function Name: streaming_uart_event_handler
+* Function Name: streaming_poll
 ********************************************************************************
 * Summary:
-*  UART TX and RX completion handler.
+*  Lets the transport send data it has held back to coalesce it with later
+*  data, once it has waited long enough. Call this regularly, e.g. from the
+*  main loop.
 *
 *******************************************************************************/
-static void streaming_uart_event_handler(void* handler_arg, cyhal_uart_event_t event)
+void streaming_poll(void)
 {
-    (void)handler_arg;
-
-    /* RX or TX done; release any waiting RX or TX */
-    uart_busy = false;
+    if (transport->poll != NULL)
+    {
+        transport->poll();
+    }
 }
 
 /*******************************************************************************
-* Function Name: streaming_init
+* Function Name: streaming_get_stats
 ********************************************************************************
 * Summary:
-*  Initializes the streaming interface. Call this once before using any other
-*  function in this file.
+*  Returns the transfer statistics of the selected transport.
+*
+* Parameters:
+*  stats: pointer to where the statistics will be stored
 *
 *******************************************************************************/
-void streaming_init()
+void streaming_get_stats(streaming_stats_t* stats)
 {
-    cy_rslt_t result;
-
-    /* UART configuration structure */
-    const cyhal_uart_cfg_t uart_config =
-    {
-        .data_bits       = 8,
-        .stop_bits       = 1,
-        .parity          = CYHAL_UART_PARITY_NONE,
-        .rx_buffer       = uart_rx_buffer,
-        .rx_buffer_size  = RX_BUF_SIZE,
-    };
-
-    /* Initialize the UART */
-    result = cyhal_uart_init(&uart_obj, CYBSP_DEBUG_UART_TX, CYBSP_DEBUG_UART_RX, NC, NC, NULL, &uart_config);
-    HALT_ON_ERROR(result);
-    result = cyhal_uart_set_baud(&uart_obj, UART_BAUD_RATE, NULL);
-    HALT_ON_ERROR(result);
-
-    /* Register and enable callback */
-    cyhal_uart_register_callback(&uart_obj, streaming_uart_event_handler, NULL);
-    cyhal_uart_event_t events = (cyhal_uart_event_t)(
-        CYHAL_UART_IRQ_TX_DONE | CYHAL_UART_IRQ_TX_ERROR
-        | CYHAL_UART_IRQ_RX_DONE | CYHAL_UART_IRQ_RX_ERROR);
-    cyhal_uart_enable_event(&uart_obj, events, CYHAL_ISR_PRIORITY_DEFAULT, true);
+    transport->get_stats(stats);
 }
 
 /*******************************************************************************
-* Function Name: streaming_receive
+* Function Name: streaming_get_free
 ********************************************************************************
 * Summary:
-*  Reads bytes from the streaming interface into the given buffer if available.
-*  This function may block until a preceding UART operation is complete.
-**
+*  Returns how many bytes of data of the given channel can be queued now
+*  without blocking, in the queue the channel's data goes to. Senders that
+*  must not block check this before sending.
+*
 * Parameters:
-*  data: pointer to buffer where data will be stored
-*  size: buffer size
+*  channel: the channel the data belongs to
 *
 * Return:
-*  The number of bytes received; 0 if no bytes were available.
+*  The free space in bytes; SIZE_MAX if the queue is not bounded.
 *
 *******************************************************************************/
-size_t streaming_receive(void* data, size_t size)
+size_t streaming_get_free(uint8_t channel)
 {
-    /* Ensure UART available */
-    while (uart_busy)
-        cyhal_system_delay_ms(1);
-    uart_busy = true;
+    if (transport->get_free != NULL)
+    {
+        return transport->get_free(channel);
+    }
 
-    /* Do read */
-    cy_rslt_t result = cyhal_uart_read(&uart_obj, data, &size);
-    uart_busy = false; /* TODO Unclear if this is necessary; should probably be removed */
-    if (result != CY_RSLT_SUCCESS)
-        return 0;
-    return size;
+    streaming_stats_t stats;
+    transport->get_stats(&stats);
+    if (stats.capacity == 0)
+    {
+        return SIZE_MAX;
+    }
+    return stats.queued < stats.capacity ? stats.capacity - stats.queued : 0;
 }
 
 /*******************************************************************************
-* Function Name: streaming_send
+* Function Name: streaming_is_congested
 ********************************************************************************
 * Summary:
-*  Sends the given bytes to the streaming interface. This function may block
-*  until a preceding UART operation is complete.
+*  Checks the fill level of the transmit queue against the watermarks. The
+*  link becomes congested when the queue fills beyond
+*  STREAMING_HIGH_WATERMARK and stays congested until it has drained below
+*  STREAMING_LOW_WATERMARK. A transport without a bounded queue is never
+*  congested.
 *
-* Parameters:
-*  data: pointer to data to send
-*  size: number of bytes to send
+* Return:
+*  True if the link is congested.
 *
 *******************************************************************************/
-void streaming_send(const void* data, size_t size)
+bool streaming_is_congested(void)
 {
-    /* Ensure UART available */
-    while (uart_busy)
-        cyhal_system_delay_ms(1);
-    uart_busy = true;
+    streaming_stats_t stats;
+    transport->get_stats(&stats);
 
-    /* Do write */
-    cyhal_uart_write_async(&uart_obj, (void*)data, size);
+    if (stats.capacity == 0)
+    {
+        congested = false;
+    }
+    else if (stats.queued * 100u >= stats.capacity * STREAMING_HIGH_WATERMARK)
+    {
+        congested = true;
+    }
+    else if (stats.queued * 100u < stats.capacity * STREAMING_LOW_WATERMARK)
+    {
+        congested = false;
+    }
+    return congested;
 }
 
-#endif
+/*******************************************************************************
+* Function Name: streaming_is_connected
+********************************************************************************
+* Summary:
+*  Returns true while the link to the host is up. Data sent while the link
+*  is down is dropped.
+*
+*******************************************************************************/
+bool streaming_is_connected(void)
+{
+    return transport->is_connected == NULL || transport->is_connected();
+}
@@ -34,23 +34,104 @@
 * so agrees to indemnify Cypress against all liability.
 *******************************************************************************/
 
-#include "cy_result.h"
-#include "cy_utils.h"
-#include "cyhal.h"
+#ifndef SOURCE_STREAMING_H_
+#define SOURCE_STREAMING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+* Type Definitions
+*******************************************************************************/
+/* One element of a gather list passed to streaming_sendv() */
+typedef struct
+{
+    const void* data;
+    size_t      size;
+} streaming_iovec_t;
+
+/* Transfer statistics of a transport. All counters start at zero when the
+ * transport is initialized. */
+typedef struct
+{
+    uint32_t bytes_sent;      /* Bytes handed to the link */
+    uint32_t bytes_received;  /* Bytes received from the link */
+    uint32_t bytes_dropped;   /* Bytes discarded by the transport */
+    uint32_t transfers;       /* Transfers started on the link */
+    uint32_t stalls;          /* Times a sender had to wait for queue space */
+    uint32_t queued;          /* Bytes currently waiting in the transmit queue */
+    uint32_t queued_peak;     /* Highest value of queued since init */
+    uint32_t capacity;        /* Size of the transmit queue; 0 if not bounded */
+} streaming_stats_t;
+
+/* A streaming transport backend. send, sendv and receive follow the contract
+ * of streaming_send(), streaming_sendv() and streaming_receive().
+ * sendv_channel and get_channel_endpoint are optional (may be NULL) and are
+ * only provided by backends with a separate link per channel. get_free is
+ * optional; without it, the free space of a channel is the capacity minus
+ * the queued bytes of the stats. poll is optional and is only needed by
+ * backends that hold data back. is_connected is optional; without it the
+ * link is always considered up. */
+typedef struct
+{
+    const char* name;
+    void    (*init)(void);
+    void    (*send)(const void* data, size_t size);
+    void    (*sendv)(const streaming_iovec_t* iov, size_t count);
+    bool    (*sendv_channel)(uint8_t channel, const streaming_iovec_t* iov, size_t count);
+    uint8_t (*get_channel_endpoint)(uint8_t channel);
+    size_t  (*get_free)(uint8_t channel);
+    size_t  (*receive)(void* data, size_t size);
+    void    (*flush)(void);
+    void    (*poll)(void);
+    void    (*get_stats)(streaming_stats_t* stats);
+    bool    (*is_connected)(void);
+} streaming_transport_t;
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define STREAMING_HIGH_WATERMARK    (75u)
+/* Queue fill level in percent of capacity at which the link is congested */
+#define STREAMING_LOW_WATERMARK     (25u)
+/* Queue fill level in percent of capacity at which congestion ends */
+
+/*******************************************************************************
+* Transport Backends
+*******************************************************************************/
+#ifdef COMPONENT_USBD_BASE
+extern const streaming_transport_t streaming_usb_transport;
+#endif
+#ifndef __linux__
+extern const streaming_transport_t streaming_uart_transport;
+#endif
+#ifdef __linux__
+extern const streaming_transport_t streaming_file_transport;
+void streaming_file_set_path(const char* path);
+#endif
+/* Available on Linux and with IM_ENABLE_WIFI */
+extern const streaming_transport_t streaming_udp_transport;
+extern const streaming_transport_t streaming_loopback_transport;
+size_t streaming_loopback_read(void* data, size_t size);
+void streaming_loopback_write(const void* data, size_t size);
 
 /*******************************************************************************
 * Function Prototypes
 *******************************************************************************/
+bool streaming_select(const char* name);
+const streaming_transport_t* streaming_get_transport(void);
 void streaming_init();
 void streaming_send(const void* data, size_t size);
+void streaming_sendv(const streaming_iovec_t* iov, size_t count);
+void streaming_sendv_channel(uint8_t channel, const streaming_iovec_t* iov, size_t count);
+uint8_t streaming_get_channel_endpoint(uint8_t channel);
+size_t streaming_get_free(uint8_t channel);
 size_t streaming_receive(void* data, size_t size);
+void streaming_flush(void);
+void streaming_poll(void);
+void streaming_get_stats(streaming_stats_t* stats);
+bool streaming_is_congested(void);
+bool streaming_is_connected(void);
 
-static inline void HALT_ON_ERROR(cy_rslt_t result)
-{
-    cy_rslt_decode_t decoded;
-    decoded.raw = result;
-    if (CY_RSLT_SUCCESS != decoded.raw)
-    {
-        CY_HALT();
-    }
-}
+#endif /* SOURCE_STREAMING_H_ */
@@ -0,0 +1,316 @@
+/******************************************************************************
+* File Name:   streaming_file.c
+*
+* Description: File and pseudo-terminal transport for the streaming interface.
+*              Only built on Linux, where it lets the protocol run and be
+*              benchmarked without hardware.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifdef __linux__
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <termios.h>
+#include <unistd.h>
+#include "streaming.h"
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define FILE_MAX_IOV                (16u)
+/* Maximum number of gather elements passed to writev() at once */
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+static const char*       file_path = NULL;
+static int               file_fd = -1;
+static streaming_stats_t file_stats;
+
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static void streaming_file_init(void);
+static void streaming_file_send(const void* data, size_t size);
+static void streaming_file_sendv(const streaming_iovec_t* iov, size_t count);
+static size_t streaming_file_receive(void* data, size_t size);
+static void streaming_file_flush(void);
+static void streaming_file_get_stats(streaming_stats_t* stats);
+static int streaming_file_open_pty(void);
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: streaming_file_set_path
+********************************************************************************
+* Summary:
+*  Sets the file or device to stream through. Call this before
+*  streaming_init(). If no path is set, a pseudo-terminal is created and its
+*  name is printed to stderr, so a host tool can connect to it like to a
+*  serial port.
+*
+* Parameters:
+*  path: path of the file or device, e.g. "/dev/ttyACM0"
+*
+*******************************************************************************/
+void streaming_file_set_path(const char* path)
+{
+    file_path = path;
+}
+
+/*******************************************************************************
+* Function Name: streaming_file_init
+********************************************************************************
+* Summary:
+*  Opens the file, device or pseudo-terminal. Exits the process on failure.
+*
+*******************************************************************************/
+static void streaming_file_init(void)
+{
+    if (file_path != NULL)
+    {
+        file_fd = open(file_path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    }
+    else
+    {
+        file_fd = streaming_file_open_pty();
+    }
+    if (file_fd < 0)
+    {
+        perror("streaming_file_init");
+        exit(EXIT_FAILURE);
+    }
+    memset(&file_stats, 0, sizeof(file_stats));
+}
+
+/*******************************************************************************
+* Function Name: streaming_file_open_pty
+********************************************************************************
+* Summary:
+*  Creates a raw pseudo-terminal and prints the name of its slave side.
+*
+* Return:
+*  The master file descriptor, or -1 on failure.
+*
+*******************************************************************************/
+static int streaming_file_open_pty(void)
+{
+    struct termios tio;
+    int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0)
+    {
+        return -1;
+    }
+
+    /* Binary data must pass unmodified */
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    fprintf(stderr, "Streaming on %s\n", ptsname(fd));
+    return fd;
+}
+
+/*******************************************************************************
+* Function Name: streaming_file_send
+********************************************************************************
+* Summary:
+*  Writes the given bytes. This function blocks until all bytes are written.
+*
+* Parameters:
+*  data: pointer to data to send
+*  size: number of bytes to send
+*
+*******************************************************************************/
+static void streaming_file_send(const void* data, size_t size)
+{
+    const streaming_iovec_t iov = { data, size };
+    streaming_file_sendv(&iov, 1);
+}
+
+/*******************************************************************************
+* Function Name: streaming_file_sendv
+********************************************************************************
+* Summary:
+*  Writes a list of buffers with writev(). This function blocks until all
+*  bytes are written.
+*
+* Parameters:
+*  iov: array of buffers to send, in order
+*  count: number of elements in iov
+*
+*******************************************************************************/
+static void streaming_file_sendv(const streaming_iovec_t* iov, size_t count)
+{
+    struct iovec vec[FILE_MAX_IOV];
+    bool stalled = false;
+
+    while (count > 0)
+    {
+        size_t n = count < FILE_MAX_IOV ? count : FILE_MAX_IOV;
+        for (size_t i = 0; i < n; i++)
+        {
+            vec[i].iov_base = (void*)iov[i].data;
+            vec[i].iov_len = iov[i].size;
+        }
+        iov += n;
+        count -= n;
+
+        /* Write until done, continuing after partial writes */
+        struct iovec* v = vec;
+        while (n > 0)
+        {
+            ssize_t written = writev(file_fd, v, (int)n);
+            if (written < 0)
+            {
+                if (errno == EAGAIN || errno == EINTR)
+                {
+                    struct pollfd pfd = { file_fd, POLLOUT, 0 };
+                    if (!stalled)
+                    {
+                        file_stats.stalls++;
+                        stalled = true;
+                    }
+                    poll(&pfd, 1, -1);
+                    continue;
+                }
+                /* Peer gone; count the rest as dropped */
+                for (size_t i = 0; i < n; i++)
+                {
+                    file_stats.bytes_dropped += v[i].iov_len;
+                }
+                break;
+            }
+            file_stats.bytes_sent += written;
+            file_stats.transfers++;
+            while (n > 0 && (size_t)written >= v->iov_len)
+            {
+                written -= v->iov_len;
+                v++;
+                n--;
+            }
+            if (n > 0)
+            {
+                v->iov_base = (uint8_t*)v->iov_base + written;
+                v->iov_len -= written;
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_file_receive
+********************************************************************************
+* Summary:
+*  Reads all available bytes, up to the buffer size. This function does not
+*  block.
+*
+* Parameters:
+*  data: pointer to buffer where data will be stored
+*  size: buffer size
+*
+* Return:
+*  The number of bytes received; 0 if no bytes were available.
+*
+*******************************************************************************/
+static size_t streaming_file_receive(void* data, size_t size)
+{
+    ssize_t count = read(file_fd, data, size);
+    if (count <= 0)
+    {
+        return 0;
+    }
+    file_stats.bytes_received += count;
+    return (size_t)count;
+}
+
+/*******************************************************************************
+* Function Name: streaming_file_flush
+********************************************************************************
+* Summary:
+*  Does nothing; writes complete before streaming_file_sendv() returns.
+*
+*******************************************************************************/
+static void streaming_file_flush(void)
+{
+}
+
+/*******************************************************************************
+* Function Name: streaming_file_get_stats
+********************************************************************************
+* Summary:
+*  Returns the transfer statistics of the file transport.
+*
+* Parameters:
+*  stats: pointer to where the statistics will be stored
+*
+*******************************************************************************/
+static void streaming_file_get_stats(streaming_stats_t* stats)
+{
+    *stats = file_stats;
+}
+
+/*******************************************************************************
+* Transport Definition
+*******************************************************************************/
+const streaming_transport_t streaming_file_transport =
+{
+    .name      = "file",
+    .init      = streaming_file_init,
+    .send      = streaming_file_send,
+    .sendv     = streaming_file_sendv,
+    .receive   = streaming_file_receive,
+    .flush     = streaming_file_flush,
+    .get_stats = streaming_file_get_stats,
+};
+
+#endif /* __linux__ */
+
+/* [] END OF FILE */
@@ -0,0 +1,294 @@
+/******************************************************************************
+* File Name:   streaming_loopback.c
+*
+* Description: In-memory loopback transport for the streaming interface.
+*              Used to exercise and benchmark the protocol without a link.
+*              All functions must be called from the same context.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include <string.h>
+#include "streaming.h"
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define LOOPBACK_TX_RING_SIZE       (8192u)
+/* Must be a power of two. Bytes sent and not yet read back with
+ * streaming_loopback_read(); when full, further bytes are dropped. */
+#define LOOPBACK_RX_RING_SIZE       (256u)
+/* Must be a power of two. Bytes injected with streaming_loopback_write() and
+ * not yet received. */
+
+
+/*******************************************************************************
+* Local Type Declarations
+*******************************************************************************/
+/* Byte ring. The indices run freely and are masked on access. */
+typedef struct
+{
+    uint8_t* data;
+    uint32_t size;
+    uint32_t read_index;
+    uint32_t write_index;
+} loopback_ring_t;
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+static uint8_t           loopback_tx_data[LOOPBACK_TX_RING_SIZE];
+static uint8_t           loopback_rx_data[LOOPBACK_RX_RING_SIZE];
+static loopback_ring_t   loopback_tx = { loopback_tx_data, LOOPBACK_TX_RING_SIZE, 0, 0 };
+static loopback_ring_t   loopback_rx = { loopback_rx_data, LOOPBACK_RX_RING_SIZE, 0, 0 };
+static streaming_stats_t loopback_stats;
+
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static void streaming_loopback_init(void);
+static void streaming_loopback_send(const void* data, size_t size);
+static void streaming_loopback_sendv(const streaming_iovec_t* iov, size_t count);
+static size_t streaming_loopback_receive(void* data, size_t size);
+static void streaming_loopback_flush(void);
+static void streaming_loopback_get_stats(streaming_stats_t* stats);
+static size_t loopback_ring_put(loopback_ring_t* ring, const uint8_t* data, size_t size);
+static size_t loopback_ring_get(loopback_ring_t* ring, uint8_t* data, size_t size);
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: streaming_loopback_read
+********************************************************************************
+* Summary:
+*  Reads back bytes that were sent through the loopback transport.
+*
+* Parameters:
+*  data: pointer to buffer where data will be stored
+*  size: buffer size
+*
+* Return:
+*  The number of bytes read; 0 if no bytes were available.
+*
+*******************************************************************************/
+size_t streaming_loopback_read(void* data, size_t size)
+{
+    return loopback_ring_get(&loopback_tx, (uint8_t*)data, size);
+}
+
+/*******************************************************************************
+* Function Name: streaming_loopback_write
+********************************************************************************
+* Summary:
+*  Injects bytes to be received through the loopback transport, as if they
+*  were sent by the host. Bytes that do not fit are discarded.
+*
+* Parameters:
+*  data: pointer to data to inject
+*  size: number of bytes to inject
+*
+*******************************************************************************/
+void streaming_loopback_write(const void* data, size_t size)
+{
+    loopback_ring_put(&loopback_rx, (const uint8_t*)data, size);
+}
+
+/*******************************************************************************
+* Function Name: streaming_loopback_init
+********************************************************************************
+* Summary:
+*  Initializes the loopback transport.
+*
+*******************************************************************************/
+static void streaming_loopback_init(void)
+{
+    loopback_tx.read_index = loopback_tx.write_index = 0;
+    loopback_rx.read_index = loopback_rx.write_index = 0;
+    memset(&loopback_stats, 0, sizeof(loopback_stats));
+}
+
+/*******************************************************************************
+* Function Name: streaming_loopback_send
+********************************************************************************
+* Summary:
+*  Stores the given bytes for streaming_loopback_read(). This function never
+*  blocks.
+*
+* Parameters:
+*  data: pointer to data to send
+*  size: number of bytes to send
+*
+*******************************************************************************/
+static void streaming_loopback_send(const void* data, size_t size)
+{
+    const streaming_iovec_t iov = { data, size };
+    streaming_loopback_sendv(&iov, 1);
+}
+
+/*******************************************************************************
+* Function Name: streaming_loopback_sendv
+********************************************************************************
+* Summary:
+*  Stores a list of buffers for streaming_loopback_read(). This function
+*  never blocks.
+*
+* Parameters:
+*  iov: array of buffers to send, in order
+*  count: number of elements in iov
+*
+*******************************************************************************/
+static void streaming_loopback_sendv(const streaming_iovec_t* iov, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t stored = loopback_ring_put(&loopback_tx, (const uint8_t*)iov[i].data, iov[i].size);
+        loopback_stats.bytes_sent += stored;
+        loopback_stats.bytes_dropped += iov[i].size - stored;
+    }
+    loopback_stats.transfers++;
+    if (loopback_tx.write_index - loopback_tx.read_index > loopback_stats.queued_peak)
+    {
+        loopback_stats.queued_peak = loopback_tx.write_index - loopback_tx.read_index;
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_loopback_receive
+********************************************************************************
+* Summary:
+*  Reads bytes injected with streaming_loopback_write().
+*
+* Parameters:
+*  data: pointer to buffer where data will be stored
+*  size: buffer size
+*
+* Return:
+*  The number of bytes received; 0 if no bytes were available.
+*
+*******************************************************************************/
+static size_t streaming_loopback_receive(void* data, size_t size)
+{
+    size_t count = loopback_ring_get(&loopback_rx, (uint8_t*)data, size);
+    loopback_stats.bytes_received += count;
+    return count;
+}
+
+/*******************************************************************************
+* Function Name: streaming_loopback_flush
+********************************************************************************
+* Summary:
+*  Does nothing; sent data is stored immediately.
+*
+*******************************************************************************/
+static void streaming_loopback_flush(void)
+{
+}
+
+/*******************************************************************************
+* Function Name: streaming_loopback_get_stats
+********************************************************************************
+* Summary:
+*  Returns the transfer statistics of the loopback transport.
+*
+* Parameters:
+*  stats: pointer to where the statistics will be stored
+*
+*******************************************************************************/
+static void streaming_loopback_get_stats(streaming_stats_t* stats)
+{
+    *stats = loopback_stats;
+    stats->queued = loopback_tx.write_index - loopback_tx.read_index;
+    stats->capacity = loopback_tx.size;
+}
+
+/*******************************************************************************
+* Function Name: loopback_ring_put
+********************************************************************************
+* Summary:
+*  Copies bytes into a ring, up to the free space.
+*
+* Return:
+*  The number of bytes stored.
+*
+*******************************************************************************/
+static size_t loopback_ring_put(loopback_ring_t* ring, const uint8_t* data, size_t size)
+{
+    size_t count = 0;
+    while (count < size && ring->write_index - ring->read_index < ring->size)
+    {
+        ring->data[ring->write_index++ & (ring->size - 1)] = data[count++];
+    }
+    return count;
+}
+
+/*******************************************************************************
+* Function Name: loopback_ring_get
+********************************************************************************
+* Summary:
+*  Copies bytes out of a ring, up to the given size.
+*
+* Return:
+*  The number of bytes copied.
+*
+*******************************************************************************/
+static size_t loopback_ring_get(loopback_ring_t* ring, uint8_t* data, size_t size)
+{
+    size_t count = 0;
+    while (count < size && ring->read_index != ring->write_index)
+    {
+        data[count++] = ring->data[ring->read_index++ & (ring->size - 1)];
+    }
+    return count;
+}
+
+/*******************************************************************************
+* Transport Definition
+*******************************************************************************/
+const streaming_transport_t streaming_loopback_transport =
+{
+    .name      = "loopback",
+    .init      = streaming_loopback_init,
+    .send      = streaming_loopback_send,
+    .sendv     = streaming_loopback_sendv,
+    .receive   = streaming_loopback_receive,
+    .flush     = streaming_loopback_flush,
+    .get_stats = streaming_loopback_get_stats,
+};
+
+/* [] END OF FILE */
@@ -0,0 +1,405 @@
+/******************************************************************************
+* File Name:   streaming_uart.c
+*
+* Description: Debug UART transport for the streaming interface. Data is
+*              sent from a TX ring drained by DMA.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include <string.h>
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cyhal_uart.h"
+#include "streaming.h"
+
+
+/* DEBUG UART STREAMING
+ * ====================
+ * Streaming through the debug UART has been unstable and is NOT recommended.
+ * It's not clear if the problems happen on the device or on the host PC.
+ * Problems we have seen include:
+ * - Intermittent large data chunks buffered causing halts and high latency
+ * - Dropped bytes, causing byte flips (LSB <=> MSB) and thus distorted data
+ * - Triggers a bug in .NET SerialPort, causing complete crash of the Studio
+ *
+ * The problems above were seen with an earlier version of this backend that
+ * waited for each transfer to finish before starting the next one. It now
+ * transmits from a DMA-fed ring and never waits on a prior transfer.
+ *
+ * If this didn't scare you and you still want to try it, set
+ * STREAMING_TRANSPORT to "uart" in config.h. The debug UART is then not
+ * available for retarget-io. To also drop the USB stack from the build:
+ * - Remove USBD_BASE from COMPONENT in the Makefile
+ * - Remove the emusb-device library using the Library Manager
+ * - Remove the imports folder (remnants from the emusb-device) */
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define UART_BAUD_RATE              (1000000u)
+/* NOTE: The debug UART may not support standard baud rates like 921600 due to
+ * its clock configuration, so consider this before changing. It should work
+ * well with 500000 and 1000000. I'm not sure why, but possibly because it's
+ * based on the 32 MHz MPU clock, so there's no integer divider for e.g.
+ * 921600. */
+#define RX_BUF_SIZE                 (256u)
+/* Software RX buffer filled by the UART interrupt. Holds several pipelined
+ * commands. */
+#define UART_TX_RING_SIZE           (4096u)
+/* Must be a power of two. Holds an audio packet while the previous one is
+ * being transmitted. */
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+static cyhal_uart_t  uart_obj;
+static uint8_t       uart_rx_buffer[RX_BUF_SIZE];
+
+/* TX ring drained by DMA. The indices run freely and are masked on access.
+ * uart_tx_active is the length of the DMA transfer in flight, 0 if idle. */
+static uint8_t           uart_tx_ring[UART_TX_RING_SIZE];
+static volatile uint32_t uart_tx_read_index = 0;
+static volatile uint32_t uart_tx_write_index = 0;
+static volatile size_t   uart_tx_active = 0;
+
+static streaming_stats_t uart_stats;
+
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static void streaming_uart_init(void);
+static void streaming_uart_send(const void* data, size_t size);
+static void streaming_uart_sendv(const streaming_iovec_t* iov, size_t count);
+static size_t streaming_uart_receive(void* data, size_t size);
+static void streaming_uart_flush(void);
+static void streaming_uart_get_stats(streaming_stats_t* stats);
+static void streaming_uart_tx_append(const uint8_t* data, size_t size);
+static void streaming_uart_tx_start(void);
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+static inline void HALT_ON_ERROR(cy_rslt_t result)
+{
+    cy_rslt_decode_t decoded;
+    decoded.raw = result;
+    if (CY_RSLT_SUCCESS != decoded.raw)
+    {
+        CY_HALT();
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_uart_event_handler
+********************************************************************************
+* Summary:
+*  UART TX completion handler. Releases the transmitted part of the TX ring
+*  and starts the next DMA transfer.
+*
+*******************************************************************************/
+static void streaming_uart_event_handler(void* handler_arg, cyhal_uart_event_t event)
+{
+    (void)handler_arg;
+
+    if (event & (CYHAL_UART_IRQ_TX_DONE | CYHAL_UART_IRQ_TX_ERROR))
+    {
+        if (event & CYHAL_UART_IRQ_TX_DONE)
+        {
+            uart_stats.bytes_sent += uart_tx_active;
+        }
+        else
+        {
+            uart_stats.bytes_dropped += uart_tx_active;
+        }
+        uart_tx_read_index += uart_tx_active;
+        uart_tx_active = 0;
+        streaming_uart_tx_start();
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_uart_init
+********************************************************************************
+* Summary:
+*  Initializes the debug UART transport.
+*
+*******************************************************************************/
+static void streaming_uart_init(void)
+{
+    cy_rslt_t result;
+
+    /* UART configuration structure */
+    const cyhal_uart_cfg_t uart_config =
+    {
+        .data_bits       = 8,
+        .stop_bits       = 1,
+        .parity          = CYHAL_UART_PARITY_NONE,
+        .rx_buffer       = uart_rx_buffer,
+        .rx_buffer_size  = RX_BUF_SIZE,
+    };
+
+    /* Initialize the UART */
+    result = cyhal_uart_init(&uart_obj, CYBSP_DEBUG_UART_TX, CYBSP_DEBUG_UART_RX, NC, NC, NULL, &uart_config);
+    HALT_ON_ERROR(result);
+    result = cyhal_uart_set_baud(&uart_obj, UART_BAUD_RATE, NULL);
+    HALT_ON_ERROR(result);
+
+    /* Transmit with DMA so the CPU is not involved per byte */
+    result = cyhal_uart_set_async_mode(&uart_obj, CYHAL_ASYNC_DMA, CYHAL_DMA_PRIORITY_DEFAULT);
+    HALT_ON_ERROR(result);
+
+    /* Register and enable callback. Received bytes are collected into
+     * uart_rx_buffer by the HAL interrupt without a callback. */
+    cyhal_uart_register_callback(&uart_obj, streaming_uart_event_handler, NULL);
+    cyhal_uart_event_t events = (cyhal_uart_event_t)(CYHAL_UART_IRQ_TX_DONE | CYHAL_UART_IRQ_TX_ERROR);
+    cyhal_uart_enable_event(&uart_obj, events, CYHAL_ISR_PRIORITY_DEFAULT, true);
+}
+
+/*******************************************************************************
+* Function Name: streaming_uart_receive
+********************************************************************************
+* Summary:
+*  Reads all available bytes from the streaming interface into the given
+*  buffer, up to its size. This function does not block.
+**
+* Parameters:
+*  data: pointer to buffer where data will be stored
+*  size: buffer size
+*
+* Return:
+*  The number of bytes received; 0 if no bytes were available.
+*
+*******************************************************************************/
+static size_t streaming_uart_receive(void* data, size_t size)
+{
+    size_t available = cyhal_uart_readable(&uart_obj);
+    if (available == 0)
+        return 0;
+    if (size > available)
+        size = available;
+
+    /* Do read; the bytes are already buffered, so this does not wait */
+    cy_rslt_t result = cyhal_uart_read(&uart_obj, data, &size);
+    if (result != CY_RSLT_SUCCESS)
+        return 0;
+    uart_stats.bytes_received += size;
+    return size;
+}
+
+/*******************************************************************************
+* Function Name: streaming_uart_send
+********************************************************************************
+* Summary:
+*  Queues the given bytes for transmission and returns immediately. The data
+*  is copied, so the caller may reuse its buffer. This function only blocks
+*  if the TX ring is full.
+*
+* Parameters:
+*  data: pointer to data to send
+*  size: number of bytes to send
+*
+*******************************************************************************/
+static void streaming_uart_send(const void* data, size_t size)
+{
+    const streaming_iovec_t iov = { data, size };
+    streaming_uart_sendv(&iov, 1);
+}
+
+/*******************************************************************************
+* Function Name: streaming_uart_sendv
+********************************************************************************
+* Summary:
+*  Queues a list of buffers for transmission and returns immediately. The
+*  data is copied, so the caller may reuse its buffers. This function only
+*  blocks if the TX ring is full.
+*
+* Parameters:
+*  iov: array of buffers to send, in order
+*  count: number of elements in iov
+*
+*******************************************************************************/
+static void streaming_uart_sendv(const streaming_iovec_t* iov, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        streaming_uart_tx_append((const uint8_t*)iov[i].data, iov[i].size);
+    }
+
+    /* Start transmission unless a transfer is already in flight */
+    uint32_t state = cyhal_system_critical_section_enter();
+    streaming_uart_tx_start();
+    cyhal_system_critical_section_exit(state);
+}
+
+/*******************************************************************************
+* Function Name: streaming_uart_flush
+********************************************************************************
+* Summary:
+*  Blocks until all queued data has been transmitted.
+*
+*******************************************************************************/
+static void streaming_uart_flush(void)
+{
+    while (uart_tx_read_index != uart_tx_write_index)
+    {
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_uart_get_stats
+********************************************************************************
+* Summary:
+*  Returns the transfer statistics of the debug UART transport.
+*
+* Parameters:
+*  stats: pointer to where the statistics will be stored
+*
+*******************************************************************************/
+static void streaming_uart_get_stats(streaming_stats_t* stats)
+{
+    uint32_t state = cyhal_system_critical_section_enter();
+    *stats = uart_stats;
+    stats->queued = uart_tx_write_index - uart_tx_read_index;
+    stats->capacity = UART_TX_RING_SIZE;
+    cyhal_system_critical_section_exit(state);
+}
+
+/*******************************************************************************
+* Function Name: streaming_uart_tx_append
+********************************************************************************
+* Summary:
+*  Copies bytes into the TX ring. While the ring is full, this function spins
+*  until the TX completion handler releases space.
+*
+* Parameters:
+*  data: pointer to data to append
+*  size: number of bytes to append
+*
+*******************************************************************************/
+static void streaming_uart_tx_append(const uint8_t* data, size_t size)
+{
+    bool stalled = false;
+
+    while (size > 0)
+    {
+        uint32_t state;
+        size_t space = UART_TX_RING_SIZE - (uart_tx_write_index - uart_tx_read_index);
+
+        if (space == 0)
+        {
+            if (!stalled)
+            {
+                uart_stats.stalls++;
+                stalled = true;
+            }
+
+            /* Make sure the ring is draining */
+            state = cyhal_system_critical_section_enter();
+            streaming_uart_tx_start();
+            cyhal_system_critical_section_exit(state);
+            continue;
+        }
+
+        /* Copy up to the end of the ring; the rest wraps on the next pass */
+        uint32_t offset = uart_tx_write_index & (UART_TX_RING_SIZE - 1);
+        size_t n = UART_TX_RING_SIZE - offset;
+        if (n > space)
+            n = space;
+        if (n > size)
+            n = size;
+        memcpy(&uart_tx_ring[offset], data, n);
+
+        state = cyhal_system_critical_section_enter();
+        uart_tx_write_index += n;
+        if (uart_tx_write_index - uart_tx_read_index > uart_stats.queued_peak)
+        {
+            uart_stats.queued_peak = uart_tx_write_index - uart_tx_read_index;
+        }
+        cyhal_system_critical_section_exit(state);
+
+        data += n;
+        size -= n;
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_uart_tx_start
+********************************************************************************
+* Summary:
+*  Starts a DMA transfer of the oldest contiguous part of the TX ring if no
+*  transfer is in flight. Must be called with interrupts disabled or from the
+*  UART interrupt. If the transfer cannot be started, no completion event
+*  follows, so its data is dropped like that of a failed transfer and the
+*  ring keeps draining.
+*
+*******************************************************************************/
+static void streaming_uart_tx_start(void)
+{
+    if (uart_tx_active != 0 || uart_tx_read_index == uart_tx_write_index)
+        return;
+
+    /* Transfer up to the end of the ring; the wrapped part follows next */
+    uint32_t offset = uart_tx_read_index & (UART_TX_RING_SIZE - 1);
+    size_t n = uart_tx_write_index - uart_tx_read_index;
+    if (n > UART_TX_RING_SIZE - offset)
+        n = UART_TX_RING_SIZE - offset;
+
+    uart_tx_active = n;
+    uart_stats.transfers++;
+    if (CY_RSLT_SUCCESS != cyhal_uart_write_async(&uart_obj, &uart_tx_ring[offset], n))
+    {
+        uart_stats.bytes_dropped += n;
+        uart_tx_read_index += n;
+        uart_tx_active = 0;
+    }
+}
+
+/*******************************************************************************
+* Transport Definition
+*******************************************************************************/
+const streaming_transport_t streaming_uart_transport =
+{
+    .name      = "uart",
+    .init      = streaming_uart_init,
+    .send      = streaming_uart_send,
+    .sendv     = streaming_uart_sendv,
+    .receive   = streaming_uart_receive,
+    .flush     = streaming_uart_flush,
+    .get_stats = streaming_uart_get_stats,
+};
+
+/* [] END OF FILE */
@@ -0,0 +1,464 @@
+/******************************************************************************
+* File Name:   streaming_udp.c
+*
+* Description: This file implements the UDP streaming transport. The serial
+*              byte stream is batched into datagrams with sequence numbers, see
+*              PROTOCOL.md section 1.2. The socket layer (udp_socket.h) is lwIP
+*              on the target and BSD sockets on Linux.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include "config.h"
+
+#if defined(__linux__) || IM_ENABLE_WIFI
+
+#include <string.h>
+#include "clock.h"
+#include "streaming.h"
+#include "udp_socket.h"
+#ifndef __linux__
+#include "cyhal.h"
+#endif
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define UDP_POOL_SIZE               (8u)
+/* Number of datagram buffers. A buffer is filled by the sender and then
+ * owned by the socket layer until the datagram has left. */
+#define UDP_HEADER_SIZE             (6u)
+/* Sequence number (u32) and offset of the first packet (u16) */
+#define UDP_NO_PACKET_START         (0xFFFFu)
+/* First packet offset of a datagram that only continues an earlier packet */
+#define UDP_FLUSH_TIMEOUT_MS        (10u)
+/* Time in ms a partly filled datagram may wait for more data */
+#define UDP_RX_BUFFER_SIZE          (256u)
+/* Largest command datagram accepted */
+
+#ifdef __linux__
+/* On Linux the socket releases buffers synchronously, so no locking needed */
+#define UDP_LOCK()                  (0u)
+#define UDP_UNLOCK(state)           ((void)(state))
+#else
+/* Buffers are released from the network stack thread */
+#define UDP_LOCK()                  cyhal_system_critical_section_enter()
+#define UDP_UNLOCK(state)           cyhal_system_critical_section_exit(state)
+#endif
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+/* Buffer pool; udp_free holds the free buffers as a stack */
+static udp_buffer_t      udp_pool[UDP_POOL_SIZE];
+static udp_buffer_t*     udp_free[UDP_POOL_SIZE];
+static uint32_t          udp_free_count = 0;
+
+/* The datagram being filled, NULL if none, with the offset of the first
+ * packet that starts in it */
+static udp_buffer_t*     udp_open = NULL;
+static uint16_t          udp_open_first = UDP_NO_PACKET_START;
+static uint32_t          udp_open_time = 0;
+static uint32_t          udp_sequence = 0;
+
+/* The host is the sender of the most recent datagram; until a datagram has
+ * been received, sent data is dropped */
+static udp_address_t     udp_host;
+static bool              udp_host_known = false;
+
+static uint8_t           udp_rx[UDP_RX_BUFFER_SIZE];
+static size_t            udp_rx_size = 0;
+static size_t            udp_rx_offset = 0;
+
+static streaming_stats_t udp_stats;
+static volatile uint32_t udp_queued = 0;
+
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static void streaming_udp_init(void);
+static void streaming_udp_send(const void* data, size_t size);
+static void streaming_udp_sendv(const streaming_iovec_t* iov, size_t count);
+static size_t streaming_udp_receive(void* data, size_t size);
+static void streaming_udp_flush(void);
+static void streaming_udp_poll(void);
+static void streaming_udp_get_stats(streaming_stats_t* stats);
+static bool streaming_udp_append(const uint8_t* data, size_t size, bool packet_start);
+static void streaming_udp_submit(void);
+static udp_buffer_t* streaming_udp_alloc(void);
+static void streaming_udp_release(udp_buffer_t* buffer);
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: streaming_udp_init
+********************************************************************************
+* Summary:
+*  Initializes the buffer pool and opens the socket on STREAMING_UDP_PORT.
+*
+*******************************************************************************/
+static void streaming_udp_init(void)
+{
+    for (uint32_t i = 0; i < UDP_POOL_SIZE; i++)
+    {
+        udp_pool[i].release = streaming_udp_release;
+        udp_free[i] = &udp_pool[i];
+    }
+    udp_free_count = UDP_POOL_SIZE;
+
+    udp_socket_open(STREAMING_UDP_PORT);
+}
+
+/*******************************************************************************
+* Function Name: streaming_udp_receive
+********************************************************************************
+* Summary:
+*  Reads received command bytes into the given buffer, up to its size, and
+*  registers their sender as the host. This function does not block.
+*
+* Parameters:
+*  data: pointer to buffer where data will be stored
+*  size: buffer size
+*
+* Return:
+*  The number of bytes received; 0 if no bytes were available.
+*
+*******************************************************************************/
+static size_t streaming_udp_receive(void* data, size_t size)
+{
+    if (udp_rx_offset == udp_rx_size)
+    {
+        udp_address_t from;
+
+        udp_rx_offset = 0;
+        udp_rx_size = udp_socket_receive(udp_rx, sizeof(udp_rx), &from);
+        if (udp_rx_size == 0)
+        {
+            return 0;
+        }
+        udp_host = from;
+        udp_host_known = true;
+        udp_stats.bytes_received += udp_rx_size;
+    }
+
+    size_t n = udp_rx_size - udp_rx_offset;
+    if (n > size)
+    {
+        n = size;
+    }
+    memcpy(data, udp_rx + udp_rx_offset, n);
+    udp_rx_offset += n;
+    return n;
+}
+
+/*******************************************************************************
+* Function Name: streaming_udp_send
+********************************************************************************
+* Summary:
+*  Queues the given bytes for transmission. See streaming_udp_sendv().
+*
+* Parameters:
+*  data: pointer to data to send
+*  size: number of bytes to send
+*
+*******************************************************************************/
+static void streaming_udp_send(const void* data, size_t size)
+{
+    const streaming_iovec_t iov = { data, size };
+    streaming_udp_sendv(&iov, 1);
+}
+
+/*******************************************************************************
+* Function Name: streaming_udp_sendv
+********************************************************************************
+* Summary:
+*  Queues a list of buffers for transmission as one packet and returns
+*  immediately. Packets are batched into datagrams; a packet that fits in a
+*  datagram is not split across two. If the buffer pool is exhausted, the
+*  rest of the packet is dropped. This function does not block.
+*
+* Parameters:
+*  iov: array of buffers to send, in order
+*  count: number of elements in iov
+*
+*******************************************************************************/
+static void streaming_udp_sendv(const streaming_iovec_t* iov, size_t count)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        total += iov[i].size;
+    }
+
+    if (!udp_host_known)
+    {
+        udp_stats.bytes_dropped += total;
+        return;
+    }
+
+    /* Start a new datagram if the packet would otherwise straddle two */
+    if (udp_open != NULL && total <= UDP_BUFFER_SIZE - UDP_HEADER_SIZE &&
+        total > UDP_BUFFER_SIZE - udp_open->size)
+    {
+        streaming_udp_submit();
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!streaming_udp_append((const uint8_t*)iov[i].data, iov[i].size, i == 0))
+        {
+            /* Out of buffers; drop the rest of the packet */
+            for (i++; i < count; i++)
+            {
+                udp_stats.bytes_dropped += iov[i].size;
+            }
+            break;
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_udp_flush
+********************************************************************************
+* Summary:
+*  Sends the partly filled datagram, if any.
+*
+*******************************************************************************/
+static void streaming_udp_flush(void)
+{
+    if (udp_open != NULL)
+    {
+        streaming_udp_submit();
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_udp_poll
+********************************************************************************
+* Summary:
+*  Sends the partly filled datagram once it has waited for
+*  UDP_FLUSH_TIMEOUT_MS. Called periodically from the main loop.
+*
+*******************************************************************************/
+static void streaming_udp_poll(void)
+{
+    if (udp_open != NULL && clock_get_ms() - udp_open_time >= UDP_FLUSH_TIMEOUT_MS)
+    {
+        streaming_udp_submit();
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_udp_get_stats
+********************************************************************************
+* Summary:
+*  Returns the transfer statistics of the UDP transport.
+*
+* Parameters:
+*  stats: pointer to where the statistics will be stored
+*
+*******************************************************************************/
+static void streaming_udp_get_stats(streaming_stats_t* stats)
+{
+    uint32_t state = UDP_LOCK();
+    *stats = udp_stats;
+    stats->queued = udp_queued;
+    stats->capacity = UDP_POOL_SIZE * (UDP_BUFFER_SIZE - UDP_HEADER_SIZE);
+    UDP_UNLOCK(state);
+}
+
+/*******************************************************************************
+* Function Name: streaming_udp_append
+********************************************************************************
+* Summary:
+*  Copies bytes into the open datagram, sending it and opening the next one
+*  whenever it is full.
+*
+* Parameters:
+*  data: pointer to data to append
+*  size: number of bytes to append
+*  packet_start: the data starts a new packet
+*
+* Return:
+*  True if all bytes were appended; false if the pool ran out of buffers and
+*  the remaining bytes were dropped.
+*
+*******************************************************************************/
+static bool streaming_udp_append(const uint8_t* data, size_t size, bool packet_start)
+{
+    while (size > 0)
+    {
+        if (udp_open == NULL)
+        {
+            udp_open = streaming_udp_alloc();
+            if (udp_open == NULL)
+            {
+                udp_stats.stalls++;
+                udp_stats.bytes_dropped += size;
+                return false;
+            }
+            udp_open->size = UDP_HEADER_SIZE;
+            udp_open_first = UDP_NO_PACKET_START;
+            udp_open_time = clock_get_ms();
+        }
+
+        size_t n = UDP_BUFFER_SIZE - udp_open->size;
+        if (n == 0)
+        {
+            streaming_udp_submit();
+            continue;
+        }
+        if (n > size)
+        {
+            n = size;
+        }
+
+        /* Record where the first packet of the datagram starts, so the host
+         * can resynchronize after a lost datagram */
+        if (packet_start && udp_open_first == UDP_NO_PACKET_START)
+        {
+            udp_open_first = udp_open->size - UDP_HEADER_SIZE;
+        }
+        packet_start = false;
+
+        memcpy(udp_open->data + udp_open->size, data, n);
+        udp_open->size += n;
+
+        uint32_t state = UDP_LOCK();
+        udp_queued += n;
+        if (udp_queued > udp_stats.queued_peak)
+        {
+            udp_stats.queued_peak = udp_queued;
+        }
+        UDP_UNLOCK(state);
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: streaming_udp_submit
+********************************************************************************
+* Summary:
+*  Fills in the header of the open datagram and passes it to the socket
+*  layer.
+*
+*******************************************************************************/
+static void streaming_udp_submit(void)
+{
+    udp_buffer_t* buffer = udp_open;
+    size_t size = buffer->size;
+
+    buffer->data[0] = udp_sequence & 0xFF;
+    buffer->data[1] = (udp_sequence >> 8) & 0xFF;
+    buffer->data[2] = (udp_sequence >> 16) & 0xFF;
+    buffer->data[3] = (udp_sequence >> 24) & 0xFF;
+    buffer->data[4] = udp_open_first & 0xFF;
+    buffer->data[5] = udp_open_first >> 8;
+    udp_sequence++;
+    udp_open = NULL;
+
+    udp_stats.transfers++;
+    if (udp_socket_send(&udp_host, buffer))
+    {
+        udp_stats.bytes_sent += size;
+    }
+    else
+    {
+        udp_stats.bytes_dropped += size;
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_udp_alloc
+********************************************************************************
+* Summary:
+*  Takes a buffer from the pool.
+*
+* Return:
+*  The buffer, or NULL if all buffers are in use.
+*
+*******************************************************************************/
+static udp_buffer_t* streaming_udp_alloc(void)
+{
+    udp_buffer_t* buffer = NULL;
+    uint32_t state = UDP_LOCK();
+    if (udp_free_count > 0)
+    {
+        buffer = udp_free[--udp_free_count];
+    }
+    UDP_UNLOCK(state);
+    return buffer;
+}
+
+/*******************************************************************************
+* Function Name: streaming_udp_release
+********************************************************************************
+* Summary:
+*  Returns a buffer to the pool. Called by the socket layer when a datagram
+*  has been sent.
+*
+*******************************************************************************/
+static void streaming_udp_release(udp_buffer_t* buffer)
+{
+    uint32_t state = UDP_LOCK();
+    udp_queued -= buffer->size - UDP_HEADER_SIZE;
+    udp_free[udp_free_count++] = buffer;
+    UDP_UNLOCK(state);
+}
+
+/*******************************************************************************
+* Transport Definition
+*******************************************************************************/
+const streaming_transport_t streaming_udp_transport =
+{
+    .name      = "udp",
+    .init      = streaming_udp_init,
+    .send      = streaming_udp_send,
+    .sendv     = streaming_udp_sendv,
+    .receive   = streaming_udp_receive,
+    .flush     = streaming_udp_flush,
+    .poll      = streaming_udp_poll,
+    .get_stats = streaming_udp_get_stats,
+};
+
+#endif /* __linux__ || IM_ENABLE_WIFI */
+
+/* [] END OF FILE */
@@ -0,0 +1,1142 @@
+/******************************************************************************
+* File Name:   streaming_usb.c
+*
+* Description: USB CDC transport for the streaming interface. Data is
+*              sent from a ring of transfer buffers drained by the USB
+*              interrupt, and received through an RX ring.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifdef COMPONENT_USBD_BASE
+
+#include <string.h>
+#include "cyhal.h"
+#include "clock.h"
+#include "config.h"
+#include "streaming.h"
+#include "usb_audio.h"
+#include "USB.h"
+#include "USB_CDC.h"
+#if IM_ENABLE_USB_CHANNEL_ENDPOINTS
+#include "USB_Bulk.h"
+#endif
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define TX_QUEUE_DEPTH              (4u)
+/* Number of transfer buffers in the CDC TX ring. One buffer is in flight
+ * while the producers fill the next ones. */
+#define TX_CHANNEL_QUEUE_DEPTH      (2u)
+/* Number of transfer buffers in the TX ring of each channel endpoint */
+#define TX_BUFFER_SIZE              (2048u)
+/* Size of a transfer buffer. Large enough for a full audio frame, so an
+ * audio packet needs at most two transfers. */
+#define TX_TRANSFER_SIZE            (TX_BUFFER_SIZE - 1u)
+/* Maximum size of one USB transfer. One byte short of a multiple of the
+ * bulk max packet size, so a full transfer ends with a short packet and
+ * needs no zero-length packet. */
+#define TX_COALESCE_TIMEOUT_MS      (2u)
+/* Time in ms that less than a full USB packet of data may wait in the open
+ * buffer for more data before it is sent as a short packet */
+#define RX_RING_SIZE                (256u)
+/* Must be a power of two. Holds several OUT packets of pipelined commands. */
+
+
+/*******************************************************************************
+* Local Type Declarations
+*******************************************************************************/
+static const USB_DEVICE_INFO usb_deviceInfo = {
+    0x058B,                       /* VendorId    */
+    0x027D,                       /* ProductId    */
+    "Infineon Technologies",      /* VendorName   */
+    "Imagimob Streamer Example",  /* ProductName  */
+    "12345678"                    /* SerialNumber */
+};
+
+typedef struct
+{
+    uint8_t         data[TX_BUFFER_SIZE];
+    volatile size_t size;
+} tx_buffer_t;
+
+/* TX ring of one IN endpoint. Buffers from read_index up to (but not
+ * including) write_index are committed for transmission; the one at
+ * read_index is in flight while active is set. The buffer at write_index is
+ * open and is filled by streaming_usb_tx_append(). While filling is set, the
+ * TX complete event does not commit the open buffer. open_time is the time
+ * the oldest byte in the open buffer was appended. */
+typedef struct tx_queue
+{
+    tx_buffer_t*       buffers;
+    uint32_t           depth;
+    volatile uint32_t  read_index;
+    volatile uint32_t  write_index;
+    volatile bool      active;
+    volatile bool      filling;
+    volatile uint32_t  open_time;
+    uint32_t           index;  /* Index of the class instance, for write, remaining and cancel */
+    void               (*write)(const struct tx_queue* queue, const void* data, size_t size);
+    size_t             (*remaining)(const struct tx_queue* queue);
+    void               (*cancel)(const struct tx_queue* queue);
+    USB_EVENT_CALLBACK event;
+} tx_queue_t;
+
+
+/*******************************************************************************
+* Local Constants
+*******************************************************************************/
+#if IM_ENABLE_USB_CHANNEL_ENDPOINTS
+static const uint8_t usb_endpoint_channels[] = USB_ENDPOINT_CHANNELS;
+#define USB_ENDPOINT_COUNT (sizeof(usb_endpoint_channels) / sizeof(usb_endpoint_channels[0]))
+#endif
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+static USB_CDC_HANDLE     usb_cdcHandle;
+static USB_EVENT_CALLBACK usb_rx_event;
+static USB_HOOK           usb_state_hook;
+
+/* The device is configured by the host and not suspended. Set and cleared
+ * by the state change callback. When the link is lost, the callback cancels
+ * the transfers in flight and sets usb_reset_pending; the queued data is
+ * discarded from the main loop, which owns the open buffers. */
+static volatile bool      usb_connected = false;
+static volatile bool      usb_reset_pending = false;
+
+/* CDC TX ring, used for responses and for channels without an endpoint */
+static tx_buffer_t        tx_cdc_buffers[TX_QUEUE_DEPTH];
+static tx_queue_t         tx_cdc_queue;
+
+#if IM_ENABLE_USB_CHANNEL_ENDPOINTS
+/* One vendor-class bulk IN endpoint with its own TX ring per channel */
+static USB_BULK_HANDLE    usb_bulkHandles[USB_ENDPOINT_COUNT];
+static uint8_t            usb_endpoint_addresses[USB_ENDPOINT_COUNT];
+static tx_buffer_t        tx_channel_buffers[USB_ENDPOINT_COUNT][TX_CHANNEL_QUEUE_DEPTH];
+static tx_queue_t         tx_channel_queues[USB_ENDPOINT_COUNT];
+#endif
+
+/* RX ring, filled with whole OUT packets and drained by streaming_receive().
+ * The indices run freely and are masked on access. rx_pending is set by the
+ * RX event when the CDC driver holds received data. */
+static uint8_t            rx_ring[RX_RING_SIZE];
+static uint32_t           rx_read_index = 0;
+static uint32_t           rx_write_index = 0;
+static volatile bool      rx_pending = false;
+
+static streaming_stats_t  usb_stats;
+static volatile uint32_t  usb_queued = 0;
+
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static void streaming_usb_init(void);
+static void streaming_usb_send(const void* data, size_t size);
+static void streaming_usb_sendv(const streaming_iovec_t* iov, size_t count);
+static bool streaming_usb_sendv_channel(uint8_t channel, const streaming_iovec_t* iov, size_t count);
+static uint8_t streaming_usb_get_channel_endpoint(uint8_t channel);
+static size_t streaming_usb_get_free(uint8_t channel);
+static size_t streaming_usb_receive(void* data, size_t size);
+static void streaming_usb_flush(void);
+static void streaming_usb_poll(void);
+static void streaming_usb_get_stats(streaming_stats_t* stats);
+static bool streaming_usb_is_connected(void);
+static void streaming_usb_state_changed(void* context, U8 state);
+static void streaming_usb_check_link(void);
+static void streaming_usb_add_cdc(void);
+static void streaming_usb_cdc_write(const tx_queue_t* queue, const void* data, size_t size);
+static size_t streaming_usb_cdc_remaining(const tx_queue_t* queue);
+static void streaming_usb_cdc_cancel(const tx_queue_t* queue);
+#if IM_ENABLE_USB_CHANNEL_ENDPOINTS
+static void streaming_usb_add_channel_endpoints(void);
+static void streaming_usb_bulk_write(const tx_queue_t* queue, const void* data, size_t size);
+static size_t streaming_usb_bulk_remaining(const tx_queue_t* queue);
+static void streaming_usb_bulk_cancel(const tx_queue_t* queue);
+#endif
+static void streaming_usb_tx_init(tx_queue_t* queue, tx_buffer_t* buffers, uint32_t depth);
+static void streaming_usb_tx_reset(tx_queue_t* queue);
+static void streaming_usb_tx_sendv(tx_queue_t* queue, const streaming_iovec_t* iov, size_t count);
+static void streaming_usb_tx_flush(tx_queue_t* queue);
+static size_t streaming_usb_tx_free(const tx_queue_t* queue);
+static void streaming_usb_tx_append(tx_queue_t* queue, const uint8_t* data, size_t size);
+static void streaming_usb_tx_commit(tx_queue_t* queue);
+static void streaming_usb_tx_start(tx_queue_t* queue, bool force);
+static size_t streaming_usb_tx_cut(size_t size);
+static void streaming_usb_tx_event(unsigned events, void* context);
+static void streaming_usb_rx_event(unsigned events, void* context);
+static void streaming_usb_rx_fill(void);
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: streaming_usb_init
+********************************************************************************
+* Summary:
+*  Initializes the USB CDC transport and starts the USB stack. This function
+*  does not wait for the host; enumeration completes in the background and
+*  data is only sent while the device is configured.
+*
+*******************************************************************************/
+static void streaming_usb_init(void)
+{
+    /* Initializes the USB stack */
+    USBD_Init();
+
+    /* Endpoint Initialization for CDC class */
+    streaming_usb_add_cdc();
+
+#if IM_ENABLE_USB_AUDIO || IM_ENABLE_USB_CHANNEL_ENDPOINTS
+    /* Composite device; the interface association descriptors group the
+     * interfaces of each class */
+    USBD_EnableIAD();
+#endif
+#if IM_ENABLE_USB_AUDIO
+    usb_audio_add();
+#endif
+#if IM_ENABLE_USB_CHANNEL_ENDPOINTS
+    streaming_usb_add_channel_endpoints();
+#endif
+
+    /* Follow attach, configuration, suspend and detach */
+    USBD_RegisterSCHook(&usb_state_hook, streaming_usb_state_changed, NULL);
+
+    /* Set device info used in enumeration */
+    USBD_SetDeviceInfo(&usb_deviceInfo);
+
+    /* Start the USB stack */
+    USBD_Start();
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_receive
+********************************************************************************
+* Summary:
+*  Reads all available bytes from the streaming interface into the given
+*  buffer, up to its size. This function does not block.
+**
+* Parameters:
+*  data: pointer to buffer where data will be stored
+*  size: buffer size
+*
+* Return:
+*  The number of bytes received; 0 if no bytes were available.
+*
+*******************************************************************************/
+static size_t streaming_usb_receive(void* data, size_t size)
+{
+    uint8_t* p = (uint8_t*)data;
+    size_t count = 0;
+
+    /* Move received OUT packets into the ring */
+    if (rx_pending)
+    {
+        streaming_usb_rx_fill();
+    }
+
+    /* Copy out everything available */
+    while (count < size && rx_read_index != rx_write_index)
+    {
+        p[count++] = rx_ring[rx_read_index++ & (RX_RING_SIZE - 1)];
+    }
+    return count;
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_rx_fill
+********************************************************************************
+* Summary:
+*  Moves the OUT packet held by the CDC driver into the RX ring. If the ring
+*  does not have room for a full packet, the data is left in the driver (and
+*  the host is NAKed) until the ring has been drained.
+*
+*******************************************************************************/
+static void streaming_usb_rx_fill(void)
+{
+    uint8_t packet[USB_FS_BULK_MAX_PACKET_SIZE];
+
+    if (RX_RING_SIZE - (rx_write_index - rx_read_index) < sizeof(packet))
+    {
+        return;
+    }
+
+    /* The RX event signalled that data is buffered, so this returns without
+     * waiting. A packet arriving after this point sets rx_pending again. */
+    rx_pending = false;
+    int received = USBD_CDC_Receive(usb_cdcHandle, packet, sizeof(packet), 1);
+    for (int i = 0; i < received; i++)
+    {
+        rx_ring[rx_write_index++ & (RX_RING_SIZE - 1)] = packet[i];
+    }
+    if (received > 0)
+    {
+        usb_stats.bytes_received += received;
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_rx_event
+********************************************************************************
+* Summary:
+*  USB CDC RX event handler, called from the USB interrupt when an OUT packet
+*  has been received.
+*
+* Parameters:
+*  events: event mask (not used)
+*  context: not used
+*
+*******************************************************************************/
+static void streaming_usb_rx_event(unsigned events, void* context)
+{
+    (void)events;
+    (void)context;
+
+    rx_pending = true;
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_send
+********************************************************************************
+* Summary:
+*  Queues the given bytes for transmission on the CDC interface and returns
+*  immediately. The data is copied, so the caller may reuse its buffer. This
+*  function only blocks if all transmit buffers are in use.
+*
+* Parameters:
+*  data: pointer to data to send
+*  size: number of bytes to send
+*
+*******************************************************************************/
+static void streaming_usb_send(const void* data, size_t size)
+{
+    const streaming_iovec_t iov = { data, size };
+    streaming_usb_tx_sendv(&tx_cdc_queue, &iov, 1);
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_sendv
+********************************************************************************
+* Summary:
+*  Queues a list of buffers for transmission on the CDC interface as one
+*  contiguous block and returns immediately. See streaming_usb_tx_sendv().
+*
+* Parameters:
+*  iov: array of buffers to send, in order
+*  count: number of elements in iov
+*
+*******************************************************************************/
+static void streaming_usb_sendv(const streaming_iovec_t* iov, size_t count)
+{
+    streaming_usb_tx_sendv(&tx_cdc_queue, iov, count);
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_sendv_channel
+********************************************************************************
+* Summary:
+*  Queues a list of buffers for transmission on the bulk endpoint of the
+*  given channel, if it has one.
+*
+* Parameters:
+*  channel: the channel the data belongs to
+*  iov: array of buffers to send, in order
+*  count: number of elements in iov
+*
+* Return:
+*  True if the data was queued; false if the channel has no endpoint.
+*
+*******************************************************************************/
+static bool streaming_usb_sendv_channel(uint8_t channel, const streaming_iovec_t* iov, size_t count)
+{
+#if IM_ENABLE_USB_CHANNEL_ENDPOINTS
+    for (uint32_t i = 0; i < USB_ENDPOINT_COUNT; i++)
+    {
+        if (usb_endpoint_channels[i] == channel)
+        {
+            streaming_usb_tx_sendv(&tx_channel_queues[i], iov, count);
+            return true;
+        }
+    }
+#else
+    (void)channel;
+    (void)iov;
+    (void)count;
+#endif
+    return false;
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_get_channel_endpoint
+********************************************************************************
+* Summary:
+*  Returns the address of the bulk IN endpoint of the given channel.
+*
+* Parameters:
+*  channel: the channel
+*
+* Return:
+*  The endpoint address, or 0 if the channel has no endpoint of its own.
+*
+*******************************************************************************/
+static uint8_t streaming_usb_get_channel_endpoint(uint8_t channel)
+{
+#if IM_ENABLE_USB_CHANNEL_ENDPOINTS
+    for (uint32_t i = 0; i < USB_ENDPOINT_COUNT; i++)
+    {
+        if (usb_endpoint_channels[i] == channel)
+        {
+            return usb_endpoint_addresses[i];
+        }
+    }
+#else
+    (void)channel;
+#endif
+    return 0;
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_get_free
+********************************************************************************
+* Summary:
+*  Returns how many bytes of data of the given channel can be queued
+*  without blocking, in the TX ring of its endpoint or in the CDC ring.
+*
+* Parameters:
+*  channel: the channel
+*
+*******************************************************************************/
+static size_t streaming_usb_get_free(uint8_t channel)
+{
+#if IM_ENABLE_USB_CHANNEL_ENDPOINTS
+    for (uint32_t i = 0; i < USB_ENDPOINT_COUNT; i++)
+    {
+        if (usb_endpoint_channels[i] == channel)
+        {
+            return streaming_usb_tx_free(&tx_channel_queues[i]);
+        }
+    }
+#else
+    (void)channel;
+#endif
+    return streaming_usb_tx_free(&tx_cdc_queue);
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_flush
+********************************************************************************
+* Summary:
+*  Blocks until all queued data has been transmitted.
+*
+*******************************************************************************/
+static void streaming_usb_flush(void)
+{
+    streaming_usb_tx_flush(&tx_cdc_queue);
+#if IM_ENABLE_USB_CHANNEL_ENDPOINTS
+    for (uint32_t i = 0; i < USB_ENDPOINT_COUNT; i++)
+    {
+        streaming_usb_tx_flush(&tx_channel_queues[i]);
+    }
+#endif
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_poll
+********************************************************************************
+* Summary:
+*  Discards the queued data of a lost link and sends partial USB packets
+*  that have waited for TX_COALESCE_TIMEOUT_MS. Called periodically from the
+*  main loop.
+*
+*******************************************************************************/
+static void streaming_usb_poll(void)
+{
+    streaming_usb_check_link();
+
+    uint32_t state = cyhal_system_critical_section_enter();
+    streaming_usb_tx_start(&tx_cdc_queue, false);
+#if IM_ENABLE_USB_CHANNEL_ENDPOINTS
+    for (uint32_t i = 0; i < USB_ENDPOINT_COUNT; i++)
+    {
+        streaming_usb_tx_start(&tx_channel_queues[i], false);
+    }
+#endif
+    cyhal_system_critical_section_exit(state);
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_is_connected
+********************************************************************************
+* Summary:
+*  Returns true while the device is configured by a host and not suspended.
+*
+*******************************************************************************/
+static bool streaming_usb_is_connected(void)
+{
+    return usb_connected;
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_state_changed
+********************************************************************************
+* Summary:
+*  USB state change callback, called from the USB interrupt on attach,
+*  configuration, suspend, resume and detach. When the link is lost, the
+*  transfers in flight are cancelled, since they would never complete, and
+*  the main loop is asked to discard the queued data. When the host
+*  configures the device again, sending resumes with the next packet.
+*
+* Parameters:
+*  context: not used
+*  state: the new state, a combination of USB_STAT_* flags
+*
+*******************************************************************************/
+static void streaming_usb_state_changed(void* context, U8 state)
+{
+    bool connected = (state & USB_STAT_CONFIGURED) && !(state & USB_STAT_SUSPENDED);
+    (void)context;
+
+    if (usb_connected && !connected)
+    {
+        tx_cdc_queue.cancel(&tx_cdc_queue);
+        tx_cdc_queue.active = false;
+#if IM_ENABLE_USB_CHANNEL_ENDPOINTS
+        for (uint32_t i = 0; i < USB_ENDPOINT_COUNT; i++)
+        {
+            tx_channel_queues[i].cancel(&tx_channel_queues[i]);
+            tx_channel_queues[i].active = false;
+        }
+#endif
+        usb_reset_pending = true;
+    }
+    usb_connected = connected;
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_check_link
+********************************************************************************
+* Summary:
+*  Discards all queued data if the link was lost since the last call. Must be
+*  called from the main loop while no TX ring is being filled.
+*
+*******************************************************************************/
+static void streaming_usb_check_link(void)
+{
+    if (usb_reset_pending)
+    {
+        usb_reset_pending = false;
+        streaming_usb_tx_reset(&tx_cdc_queue);
+#if IM_ENABLE_USB_CHANNEL_ENDPOINTS
+        for (uint32_t i = 0; i < USB_ENDPOINT_COUNT; i++)
+        {
+            streaming_usb_tx_reset(&tx_channel_queues[i]);
+        }
+#endif
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_get_stats
+********************************************************************************
+* Summary:
+*  Returns the transfer statistics of the USB transport.
+*
+* Parameters:
+*  stats: pointer to where the statistics will be stored
+*
+*******************************************************************************/
+static void streaming_usb_get_stats(streaming_stats_t* stats)
+{
+    uint32_t state = cyhal_system_critical_section_enter();
+    *stats = usb_stats;
+    stats->queued = usb_queued;
+    stats->capacity = TX_QUEUE_DEPTH * TX_TRANSFER_SIZE;
+#if IM_ENABLE_USB_CHANNEL_ENDPOINTS
+    stats->capacity += USB_ENDPOINT_COUNT * TX_CHANNEL_QUEUE_DEPTH * TX_TRANSFER_SIZE;
+#endif
+    cyhal_system_critical_section_exit(state);
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_tx_init
+********************************************************************************
+* Summary:
+*  Initializes a TX ring. The write, remaining and cancel functions must be
+*  set by the caller.
+*
+* Parameters:
+*  queue: the TX ring
+*  buffers: the transfer buffers of the ring
+*  depth: number of transfer buffers
+*
+*******************************************************************************/
+static void streaming_usb_tx_init(tx_queue_t* queue, tx_buffer_t* buffers, uint32_t depth)
+{
+    memset(queue, 0, sizeof(*queue));
+    queue->buffers = buffers;
+    queue->depth = depth;
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_tx_reset
+********************************************************************************
+* Summary:
+*  Discards all data in a TX ring, counting it as dropped. The transfer in
+*  flight, if any, must have been cancelled.
+*
+* Parameters:
+*  queue: the TX ring
+*
+*******************************************************************************/
+static void streaming_usb_tx_reset(tx_queue_t* queue)
+{
+    uint32_t state = cyhal_system_critical_section_enter();
+    for (uint32_t i = 0; i < queue->depth; i++)
+    {
+        usb_stats.bytes_dropped += queue->buffers[i].size;
+        usb_queued -= queue->buffers[i].size;
+        queue->buffers[i].size = 0;
+    }
+    queue->read_index = 0;
+    queue->write_index = 0;
+    queue->active = false;
+    cyhal_system_critical_section_exit(state);
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_tx_sendv
+********************************************************************************
+* Summary:
+*  Queues a list of buffers for transmission as one contiguous block and
+*  returns immediately. The block is packed together with the other queued
+*  data into transfers of whole USB packets, see streaming_usb_tx_start().
+*  The data is copied, so the caller may reuse its buffers. This function
+*  only blocks if all transmit buffers are in use. While the device is not
+*  configured, the data is dropped.
+*
+* Parameters:
+*  queue: the TX ring of the endpoint
+*  iov: array of buffers to send, in order
+*  count: number of elements in iov
+*
+*******************************************************************************/
+static void streaming_usb_tx_sendv(tx_queue_t* queue, const streaming_iovec_t* iov, size_t count)
+{
+    /* Discard the data of a lost link, and drop new data while there is no
+     * host to send it to */
+    streaming_usb_check_link();
+    if (!usb_connected)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            usb_stats.bytes_dropped += iov[i].size;
+        }
+        return;
+    }
+
+    queue->filling = true;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        streaming_usb_tx_append(queue, (const uint8_t*)iov[i].data, iov[i].size);
+    }
+
+    /* Start transmission unless a transfer is already in flight */
+    uint32_t state = cyhal_system_critical_section_enter();
+    queue->filling = false;
+    streaming_usb_tx_start(queue, false);
+    cyhal_system_critical_section_exit(state);
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_tx_flush
+********************************************************************************
+* Summary:
+*  Blocks until all data queued in a TX ring has been transmitted. The open
+*  buffer is sent as it is; if it happens to hold a whole number of USB
+*  packets, the driver ends the transfer with a zero-length packet.
+*
+* Parameters:
+*  queue: the TX ring
+*
+*******************************************************************************/
+static void streaming_usb_tx_flush(tx_queue_t* queue)
+{
+    /* Commit the open buffer and wait for the ring to drain, or for the
+     * link to be lost */
+    streaming_usb_check_link();
+    queue->filling = true;
+    streaming_usb_tx_commit(queue);
+    queue->filling = false;
+    while (usb_connected && (queue->active || queue->read_index != queue->write_index))
+    {
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_tx_free
+********************************************************************************
+* Summary:
+*  Returns how many bytes can be appended to a TX ring without waiting for
+*  a transfer to complete: the rest of the open buffer and the free buffers
+*  after it. Committed buffers count as full, whatever slack coalescing has
+*  left in them. The result is a lower bound, since the USB interrupt only
+*  frees buffers; it allows for the interrupt committing the open buffer
+*  and carrying its last bytes over, see streaming_usb_tx_start().
+*
+* Parameters:
+*  queue: the TX ring
+*
+*******************************************************************************/
+static size_t streaming_usb_tx_free(const tx_queue_t* queue)
+{
+    uint32_t state = cyhal_system_critical_section_enter();
+    uint32_t committed = (queue->write_index + queue->depth - queue->read_index) % queue->depth;
+    size_t open = queue->buffers[queue->write_index].size;
+    size_t space = (queue->depth - 1 - committed) * TX_TRANSFER_SIZE + (TX_TRANSFER_SIZE - open);
+    if (committed == 0 && open != 0)
+    {
+        space = (queue->depth - 1) * TX_TRANSFER_SIZE - (open - streaming_usb_tx_cut(open));
+    }
+    cyhal_system_critical_section_exit(state);
+    return space;
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_tx_append
+********************************************************************************
+* Summary:
+*  Copies bytes into the open buffer of a TX ring, committing it and moving
+*  on to the next buffer whenever it is full. Must be called with the
+*  filling flag of the ring set.
+*
+* Parameters:
+*  queue: the TX ring
+*  data: pointer to data to append
+*  size: number of bytes to append
+*
+*******************************************************************************/
+static void streaming_usb_tx_append(tx_queue_t* queue, const uint8_t* data, size_t size)
+{
+    while (size > 0)
+    {
+        tx_buffer_t* buffer = &queue->buffers[queue->write_index];
+        size_t n = TX_TRANSFER_SIZE - buffer->size;
+
+        if (n == 0)
+        {
+            streaming_usb_tx_commit(queue);
+            continue;
+        }
+        if (buffer->size == 0)
+        {
+            queue->open_time = clock_get_ms();
+        }
+        if (n > size)
+        {
+            n = size;
+        }
+        memcpy(buffer->data + buffer->size, data, n);
+        buffer->size += n;
+
+        uint32_t state = cyhal_system_critical_section_enter();
+        usb_queued += n;
+        if (usb_queued > usb_stats.queued_peak)
+        {
+            usb_stats.queued_peak = usb_queued;
+        }
+        cyhal_system_critical_section_exit(state);
+
+        data += n;
+        size -= n;
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_tx_commit
+********************************************************************************
+* Summary:
+*  Commits the open buffer of a TX ring for transmission and opens the next
+*  one. While the ring is full, this function spins until the TX complete
+*  event releases the oldest buffer. If the link is lost meanwhile, the open
+*  buffer is discarded instead. Must be called with the filling flag of the
+*  ring set.
+*
+* Parameters:
+*  queue: the TX ring
+*
+*******************************************************************************/
+static void streaming_usb_tx_commit(tx_queue_t* queue)
+{
+    bool committed = (queue->buffers[queue->write_index].size == 0);
+    bool stalled = false;
+
+    while (!committed)
+    {
+        uint32_t state = cyhal_system_critical_section_enter();
+        uint32_t next = (queue->write_index + 1) % queue->depth;
+        if (!usb_connected)
+        {
+            usb_stats.bytes_dropped += queue->buffers[queue->write_index].size;
+            usb_queued -= queue->buffers[queue->write_index].size;
+            queue->buffers[queue->write_index].size = 0;
+            committed = true;
+        }
+        else if (next != queue->read_index)
+        {
+            queue->write_index = next;
+            committed = true;
+        }
+        else if (!stalled)
+        {
+            usb_stats.stalls++;
+            stalled = true;
+        }
+        streaming_usb_tx_start(queue, false);
+        cyhal_system_critical_section_exit(state);
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_tx_start
+********************************************************************************
+* Summary:
+*  Starts a non-blocking transfer of the oldest committed buffer of a TX ring
+*  if no transfer is in flight. Must be called with interrupts disabled or
+*  from the USB interrupt.
+*
+*  If nothing is committed, the open buffer is committed up to one byte
+*  short of a multiple of the bulk max packet size, and the bytes after that
+*  are moved on to the next buffer, where more data can join them, see
+*  streaming_usb_tx_cut(). So while data keeps coming, every transfer is
+*  full packets followed by one short packet, which ends the transfer on
+*  the bus without a zero-length packet. Less than a packet of data is only
+*  sent on its own when it has waited for TX_COALESCE_TIMEOUT_MS, or when
+*  force is set.
+*
+* Parameters:
+*  queue: the TX ring
+*  force: commit the open buffer even if it holds only a partial packet
+*
+*******************************************************************************/
+static void streaming_usb_tx_start(tx_queue_t* queue, bool force)
+{
+    if (queue->active || !usb_connected)
+    {
+        return;
+    }
+
+    if (queue->read_index == queue->write_index)
+    {
+        /* Nothing committed; the open buffer must not be touched while it
+         * is being filled */
+        tx_buffer_t* buffer = &queue->buffers[queue->write_index];
+        size_t cut = streaming_usb_tx_cut(buffer->size);
+        size_t rest = buffer->size - cut;
+
+        if (queue->filling || buffer->size == 0)
+        {
+            return;
+        }
+        if (cut == 0 && !force && clock_get_ms() - queue->open_time < TX_COALESCE_TIMEOUT_MS)
+        {
+            return;
+        }
+
+        /* Commit up to the cut and carry the rest over. With nothing in
+         * flight or committed, the next buffer is free. */
+        queue->write_index = (queue->write_index + 1) % queue->depth;
+        if (cut != 0 && rest != 0)
+        {
+            tx_buffer_t* next = &queue->buffers[queue->write_index];
+            memcpy(next->data, buffer->data + cut, rest);
+            next->size = rest;
+            buffer->size = cut;
+        }
+    }
+
+    queue->active = true;
+    usb_stats.transfers++;
+    queue->write(queue, queue->buffers[queue->read_index].data, queue->buffers[queue->read_index].size);
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_tx_cut
+********************************************************************************
+* Summary:
+*  Returns how many bytes of an open buffer to send in one transfer: the
+*  most that is one byte short of a multiple of the bulk max packet size.
+*  A transfer of that size ends with a short packet, so the host sees its
+*  end without a zero-length packet.
+*
+* Parameters:
+*  size: number of bytes in the open buffer
+*
+* Return:
+*  The number of bytes to send, or 0 if the buffer holds less than that.
+*
+*******************************************************************************/
+static size_t streaming_usb_tx_cut(size_t size)
+{
+    if (size < USB_FS_BULK_MAX_PACKET_SIZE - 1)
+    {
+        return 0;
+    }
+    return ((size + 1) & ~(size_t)(USB_FS_BULK_MAX_PACKET_SIZE - 1)) - 1;
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_tx_event
+********************************************************************************
+* Summary:
+*  USB TX event handler, called from the USB interrupt. Releases the buffer
+*  of a completed transfer and starts the next one.
+*
+* Parameters:
+*  events: event mask (not used)
+*  context: the TX ring of the endpoint
+*
+*******************************************************************************/
+static void streaming_usb_tx_event(unsigned events, void* context)
+{
+    tx_queue_t* queue = (tx_queue_t*)context;
+    (void)events;
+
+    if (queue->active && queue->remaining(queue) == 0)
+    {
+        usb_stats.bytes_sent += queue->buffers[queue->read_index].size;
+        usb_queued -= queue->buffers[queue->read_index].size;
+        queue->buffers[queue->read_index].size = 0;
+        queue->read_index = (queue->read_index + 1) % queue->depth;
+        queue->active = false;
+        streaming_usb_tx_start(queue, false);
+    }
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_cdc_write
+********************************************************************************
+* Summary:
+*  Starts a non-blocking transfer on the CDC bulk IN endpoint.
+*
+*******************************************************************************/
+static void streaming_usb_cdc_write(const tx_queue_t* queue, const void* data, size_t size)
+{
+    (void)queue;
+
+    /* A negative timeout starts the transfer and returns immediately;
+     * completion is reported through streaming_usb_tx_event() */
+    USBD_CDC_Write(usb_cdcHandle, data, size, -1);
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_cdc_remaining
+********************************************************************************
+* Summary:
+*  Returns the number of bytes of the current CDC transfer not yet sent.
+*
+*******************************************************************************/
+static size_t streaming_usb_cdc_remaining(const tx_queue_t* queue)
+{
+    (void)queue;
+    return USBD_CDC_GetNumBytesRemToWrite(usb_cdcHandle);
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_cdc_cancel
+********************************************************************************
+* Summary:
+*  Cancels the current transfer on the CDC bulk IN endpoint.
+*
+*******************************************************************************/
+static void streaming_usb_cdc_cancel(const tx_queue_t* queue)
+{
+    (void)queue;
+    USBD_CDC_CancelWrite(usb_cdcHandle);
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_add_cdc
+********************************************************************************
+* Summary:
+*  Initializes USB CDC.
+*
+*******************************************************************************/
+static void streaming_usb_add_cdc(void)
+{
+    static U8             OutBuffer[USB_FS_BULK_MAX_PACKET_SIZE];
+    USB_CDC_INIT_DATA     InitData;
+    USB_ADD_EP_INFO       EPBulkIn;
+    USB_ADD_EP_INFO       EPBulkOut;
+    USB_ADD_EP_INFO       EPIntIn;
+
+    memset(&InitData, 0, sizeof(InitData));
+    EPBulkIn.Flags          = 0;                             /* Flags not used */
+    EPBulkIn.InDir          = USB_DIR_IN;                    /* IN direction (Device to Host) */
+    EPBulkIn.Interval       = 0;                             /* Interval not used for Bulk endpoints */
+    EPBulkIn.MaxPacketSize  = USB_FS_BULK_MAX_PACKET_SIZE;   /* Maximum packet size (64B for Bulk in full-speed) */
+    EPBulkIn.TransferType   = USB_TRANSFER_TYPE_BULK;        /* Endpoint type - Bulk */
+    InitData.EPIn  = USBD_AddEPEx(&EPBulkIn, NULL, 0);
+
+    EPBulkOut.Flags         = 0;                             /* Flags not used */
+    EPBulkOut.InDir         = USB_DIR_OUT;                   /* OUT direction (Host to Device) */
+    EPBulkOut.Interval      = 0;                             /* Interval not used for Bulk endpoints */
+    EPBulkOut.MaxPacketSize = USB_FS_BULK_MAX_PACKET_SIZE;   /* Maximum packet size (64B for Bulk in full-speed) */
+    EPBulkOut.TransferType  = USB_TRANSFER_TYPE_BULK;        /* Endpoint type - Bulk */
+    InitData.EPOut = USBD_AddEPEx(&EPBulkOut, OutBuffer, sizeof(OutBuffer));
+
+    EPIntIn.Flags           = 0;                             /* Flags not used */
+    EPIntIn.InDir           = USB_DIR_IN;                    /* IN direction (Device to Host) */
+    EPIntIn.Interval        = 64;                            /* Interval of 8 ms (64 * 125us) */
+    EPIntIn.MaxPacketSize   = USB_FS_INT_MAX_PACKET_SIZE ;   /* Maximum packet size (64 for Interrupt) */
+    EPIntIn.TransferType    = USB_TRANSFER_TYPE_INT;         /* Endpoint type - Interrupt */
+    InitData.EPInt = USBD_AddEPEx(&EPIntIn, NULL, 0);
+
+    usb_cdcHandle = USBD_CDC_Add(&InitData);
+
+    /* Drain the TX ring from the TX complete event and flag received data
+     * from the RX event */
+    streaming_usb_tx_init(&tx_cdc_queue, tx_cdc_buffers, TX_QUEUE_DEPTH);
+    tx_cdc_queue.write = streaming_usb_cdc_write;
+    tx_cdc_queue.remaining = streaming_usb_cdc_remaining;
+    tx_cdc_queue.cancel = streaming_usb_cdc_cancel;
+    USBD_CDC_SetOnTXEvent(usb_cdcHandle, &tx_cdc_queue.event, streaming_usb_tx_event, &tx_cdc_queue);
+    USBD_CDC_SetOnRXEvent(usb_cdcHandle, &usb_rx_event, streaming_usb_rx_event, NULL);
+}
+
+#if IM_ENABLE_USB_CHANNEL_ENDPOINTS
+
+/*******************************************************************************
+* Function Name: streaming_usb_bulk_write
+********************************************************************************
+* Summary:
+*  Starts a non-blocking transfer on the bulk IN endpoint of a channel.
+*
+*******************************************************************************/
+static void streaming_usb_bulk_write(const tx_queue_t* queue, const void* data, size_t size)
+{
+    USBD_BULK_Write(usb_bulkHandles[queue->index], data, size, -1);
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_bulk_remaining
+********************************************************************************
+* Summary:
+*  Returns the number of bytes of the current transfer on the bulk IN
+*  endpoint of a channel not yet sent.
+*
+*******************************************************************************/
+static size_t streaming_usb_bulk_remaining(const tx_queue_t* queue)
+{
+    return USBD_BULK_GetNumBytesRemToWrite(usb_bulkHandles[queue->index]);
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_bulk_cancel
+********************************************************************************
+* Summary:
+*  Cancels the current transfer on the bulk IN endpoint of a channel.
+*
+*******************************************************************************/
+static void streaming_usb_bulk_cancel(const tx_queue_t* queue)
+{
+    USBD_BULK_CancelWrite(usb_bulkHandles[queue->index]);
+}
+
+/*******************************************************************************
+* Function Name: streaming_usb_add_channel_endpoints
+********************************************************************************
+* Summary:
+*  Adds one vendor-class interface with a bulk IN endpoint for each channel
+*  in USB_ENDPOINT_CHANNELS. A large packet on one channel then no longer
+*  delays the packets of the others.
+*
+*******************************************************************************/
+static void streaming_usb_add_channel_endpoints(void)
+{
+    for (uint32_t i = 0; i < USB_ENDPOINT_COUNT; i++)
+    {
+        USB_BULK_INIT_DATA InitData;
+        USB_ADD_EP_INFO    EPBulkIn;
+
+        memset(&InitData, 0, sizeof(InitData));
+        EPBulkIn.Flags          = 0;                             /* Flags not used */
+        EPBulkIn.InDir          = USB_DIR_IN;                    /* IN direction (Device to Host) */
+        EPBulkIn.Interval       = 0;                             /* Interval not used for Bulk endpoints */
+        EPBulkIn.MaxPacketSize  = USB_FS_BULK_MAX_PACKET_SIZE;   /* Maximum packet size (64B for Bulk in full-speed) */
+        EPBulkIn.TransferType   = USB_TRANSFER_TYPE_BULK;        /* Endpoint type - Bulk */
+        InitData.EPIn = USBD_AddEPEx(&EPBulkIn, NULL, 0);
+
+        usb_bulkHandles[i] = USBD_BULK_Add(&InitData);
+        usb_endpoint_addresses[i] = InitData.EPIn;
+
+        streaming_usb_tx_init(&tx_channel_queues[i], tx_channel_buffers[i], TX_CHANNEL_QUEUE_DEPTH);
+        tx_channel_queues[i].index = i;
+        tx_channel_queues[i].write = streaming_usb_bulk_write;
+        tx_channel_queues[i].remaining = streaming_usb_bulk_remaining;
+        tx_channel_queues[i].cancel = streaming_usb_bulk_cancel;
+        USBD_BULK_SetOnTXEvent(usb_bulkHandles[i], &tx_channel_queues[i].event,
+                               streaming_usb_tx_event, &tx_channel_queues[i]);
+    }
+}
+
+#endif /* IM_ENABLE_USB_CHANNEL_ENDPOINTS */
+
+/*******************************************************************************
+* Transport Definition
+*******************************************************************************/
+const streaming_transport_t streaming_usb_transport =
+{
+    .name                 = "usb",
+    .init                 = streaming_usb_init,
+    .send                 = streaming_usb_send,
+    .sendv                = streaming_usb_sendv,
+    .sendv_channel        = streaming_usb_sendv_channel,
+    .get_channel_endpoint = streaming_usb_get_channel_endpoint,
+    .get_free             = streaming_usb_get_free,
+    .receive              = streaming_usb_receive,
+    .flush                = streaming_usb_flush,
+    .poll                 = streaming_usb_poll,
+    .get_stats            = streaming_usb_get_stats,
+    .is_connected         = streaming_usb_is_connected,
+};
+
+#endif /* COMPONENT_USBD_BASE */
+
+/* [] END OF FILE */
@@ -0,0 +1,295 @@
+/******************************************************************************
+* File Name:   tlv.c
+*
+* Description: This file contains the type-length-value encoding of the binary
+*              control messages of protocol version 2.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#include <string.h>
+#include "tlv.h"
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: tlv_begin
+********************************************************************************
+* Summary:
+*  Starts a message.
+*
+* Parameters:
+*  writer: the writer state
+*  buffer: buffer for the message
+*  size: size of the buffer
+*
+*******************************************************************************/
+void tlv_begin(tlv_writer_t* writer, uint8_t* buffer, size_t size)
+{
+    writer->buffer = buffer;
+    writer->size = size;
+    writer->length = 0;
+    writer->full = false;
+}
+
+/*******************************************************************************
+* Function Name: tlv_open
+********************************************************************************
+* Summary:
+*  Starts an item. Its value is appended with tlv_append...() or nested
+*  items, and its length is filled in by tlv_close().
+*
+* Parameters:
+*  writer: the writer state
+*  type: the type of the item
+*
+* Return:
+*  The position of the item, to pass to tlv_close().
+*
+*******************************************************************************/
+size_t tlv_open(tlv_writer_t* writer, uint8_t type)
+{
+    size_t item = writer->length;
+    tlv_append(writer, &type, 1);
+    tlv_append_u16(writer, 0);
+    return item;
+}
+
+/*******************************************************************************
+* Function Name: tlv_append
+********************************************************************************
+* Summary:
+*  Appends bytes to the value of the open item. Bytes past the end of the
+*  buffer are only counted; tlv_close() then leaves the item out.
+*
+*******************************************************************************/
+void tlv_append(tlv_writer_t* writer, const void* data, size_t size)
+{
+    if (writer->length + size <= writer->size)
+    {
+        memcpy(writer->buffer + writer->length, data, size);
+    }
+    writer->length += size;
+}
+
+/*******************************************************************************
+* Function Name: tlv_append_u16
+********************************************************************************
+* Summary:
+*  Appends a 16-bit value in little endian byte order.
+*
+*******************************************************************************/
+void tlv_append_u16(tlv_writer_t* writer, uint16_t value)
+{
+    const uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    tlv_append(writer, bytes, sizeof(bytes));
+}
+
+/*******************************************************************************
+* Function Name: tlv_append_u32
+********************************************************************************
+* Summary:
+*  Appends a 32-bit value in little endian byte order.
+*
+*******************************************************************************/
+void tlv_append_u32(tlv_writer_t* writer, uint32_t value)
+{
+    tlv_append_u16(writer, (uint16_t)value);
+    tlv_append_u16(writer, (uint16_t)(value >> 16));
+}
+
+/*******************************************************************************
+* Function Name: tlv_close
+********************************************************************************
+* Summary:
+*  Ends an item and fills in its length, or leaves it out if it does not
+*  fit in the buffer.
+*
+* Parameters:
+*  writer: the writer state
+*  item: the position returned by tlv_open()
+*
+*******************************************************************************/
+void tlv_close(tlv_writer_t* writer, size_t item)
+{
+    size_t size = writer->length - item - TLV_HEADER_SIZE;
+    if (writer->length > writer->size || size > UINT16_MAX)
+    {
+        writer->length = item;
+        writer->full = true;
+        return;
+    }
+    writer->buffer[item + 1] = (uint8_t)size;
+    writer->buffer[item + 2] = (uint8_t)(size >> 8);
+}
+
+/*******************************************************************************
+* Function Name: tlv_put
+********************************************************************************
+* Summary:
+*  Writes an item with the given value.
+*
+*******************************************************************************/
+void tlv_put(tlv_writer_t* writer, uint8_t type, const void* value, size_t size)
+{
+    size_t item = tlv_open(writer, type);
+    tlv_append(writer, value, size);
+    tlv_close(writer, item);
+}
+
+/*******************************************************************************
+* Function Name: tlv_put_u8
+********************************************************************************
+* Summary:
+*  Writes an item with an 8-bit value.
+*
+*******************************************************************************/
+void tlv_put_u8(tlv_writer_t* writer, uint8_t type, uint8_t value)
+{
+    tlv_put(writer, type, &value, 1);
+}
+
+/*******************************************************************************
+* Function Name: tlv_put_u16
+********************************************************************************
+* Summary:
+*  Writes an item with a 16-bit value, little endian.
+*
+*******************************************************************************/
+void tlv_put_u16(tlv_writer_t* writer, uint8_t type, uint16_t value)
+{
+    size_t item = tlv_open(writer, type);
+    tlv_append_u16(writer, value);
+    tlv_close(writer, item);
+}
+
+/*******************************************************************************
+* Function Name: tlv_put_u32
+********************************************************************************
+* Summary:
+*  Writes an item with a 32-bit value, little endian.
+*
+*******************************************************************************/
+void tlv_put_u32(tlv_writer_t* writer, uint8_t type, uint32_t value)
+{
+    size_t item = tlv_open(writer, type);
+    tlv_append_u32(writer, value);
+    tlv_close(writer, item);
+}
+
+/*******************************************************************************
+* Function Name: tlv_put_string
+********************************************************************************
+* Summary:
+*  Writes an item with a string value, without the terminating zero.
+*
+*******************************************************************************/
+void tlv_put_string(tlv_writer_t* writer, uint8_t type, const char* value)
+{
+    tlv_put(writer, type, value, strlen(value));
+}
+
+/*******************************************************************************
+* Function Name: tlv_reader_init
+********************************************************************************
+* Summary:
+*  Starts reading a message, or the items nested in a value.
+*
+*******************************************************************************/
+void tlv_reader_init(tlv_reader_t* reader, const uint8_t* data, size_t size)
+{
+    reader->data = data;
+    reader->size = size;
+    reader->position = 0;
+}
+
+/*******************************************************************************
+* Function Name: tlv_next
+********************************************************************************
+* Summary:
+*  Reads the next item.
+*
+* Parameters:
+*  reader: the reader state
+*  type: pointer to where the type is stored
+*  value: pointer to where a pointer to the value is stored
+*  size: pointer to where the size of the value is stored
+*
+* Return:
+*  False at the end of the message, or if the next item is cut off.
+*
+*******************************************************************************/
+bool tlv_next(tlv_reader_t* reader, uint8_t* type, const uint8_t** value, size_t* size)
+{
+    const uint8_t* p = reader->data + reader->position;
+    size_t remaining = reader->size - reader->position;
+    if (remaining < TLV_HEADER_SIZE)
+    {
+        return false;
+    }
+
+    size_t length = (size_t)p[1] | ((size_t)p[2] << 8);
+    if (remaining - TLV_HEADER_SIZE < length)
+    {
+        return false;
+    }
+    *type = p[0];
+    *value = p + TLV_HEADER_SIZE;
+    *size = length;
+    reader->position += TLV_HEADER_SIZE + length;
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: tlv_get_uint
+********************************************************************************
+* Summary:
+*  Returns an unsigned value of 1 to 4 bytes, little endian; longer values
+*  are cut to their first 4 bytes.
+*
+*******************************************************************************/
+uint32_t tlv_get_uint(const uint8_t* value, size_t size)
+{
+    uint32_t result = 0;
+    for (size_t i = 0; i < size && i < sizeof(result); i++)
+    {
+        result |= (uint32_t)value[i] << (8 * i);
+    }
+    return result;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,96 @@
+/******************************************************************************
+* File Name:   tlv.h
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+
+#ifndef SOURCE_TLV_H_
+#define SOURCE_TLV_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define TLV_HEADER_SIZE             (3u)
+/* Type (u8) and length (u16, little endian) in front of each value */
+
+/*******************************************************************************
+* Type Definitions
+*******************************************************************************/
+/* State of a message being built. Items that do not fit in the buffer are
+ * left out whole, so the message is always well formed. */
+typedef struct
+{
+    uint8_t* buffer;
+    size_t   size;
+    size_t   length;    /* Bytes written; above size while an item overflows */
+    bool     full;      /* An item was left out */
+} tlv_writer_t;
+
+/* State of a message being read */
+typedef struct
+{
+    const uint8_t* data;
+    size_t         size;
+    size_t         position;
+} tlv_reader_t;
+
+/*******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+/* Type-length-value encoding: a message is a sequence of items, each a
+ * type, the length of its value and the value, which may itself be a
+ * sequence of items. An item is written with tlv_open(), tlv_append...()
+ * and tlv_close(), or at once with tlv_put...(). */
+void tlv_begin(tlv_writer_t* writer, uint8_t* buffer, size_t size);
+size_t tlv_open(tlv_writer_t* writer, uint8_t type);
+void tlv_append(tlv_writer_t* writer, const void* data, size_t size);
+void tlv_append_u16(tlv_writer_t* writer, uint16_t value);
+void tlv_append_u32(tlv_writer_t* writer, uint32_t value);
+void tlv_close(tlv_writer_t* writer, size_t item);
+void tlv_put(tlv_writer_t* writer, uint8_t type, const void* value, size_t size);
+void tlv_put_u8(tlv_writer_t* writer, uint8_t type, uint8_t value);
+void tlv_put_u16(tlv_writer_t* writer, uint8_t type, uint16_t value);
+void tlv_put_u32(tlv_writer_t* writer, uint8_t type, uint32_t value);
+void tlv_put_string(tlv_writer_t* writer, uint8_t type, const char* value);
+void tlv_reader_init(tlv_reader_t* reader, const uint8_t* data, size_t size);
+bool tlv_next(tlv_reader_t* reader, uint8_t* type, const uint8_t** value, size_t* size);
+uint32_t tlv_get_uint(const uint8_t* value, size_t size);
+
+#endif /* SOURCE_TLV_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,83 @@
+/******************************************************************************
+* File Name:   udp_socket.h
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifndef SOURCE_UDP_SOCKET_H_
+#define SOURCE_UDP_SOCKET_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define UDP_BUFFER_SIZE             (1472u)
+/* Largest UDP payload that fits in one 1500-byte Ethernet/Wi-Fi frame
+ * without IP fragmentation */
+
+/*******************************************************************************
+* Type Definitions
+*******************************************************************************/
+/* An IPv4 address and port, both in host byte order */
+typedef struct
+{
+    uint32_t ip;
+    uint16_t port;
+} udp_address_t;
+
+/* A datagram buffer. Buffers are owned by a pool of the caller; once a
+ * buffer has been passed to udp_socket_send(), the socket owns it and hands
+ * it back by calling release when the data is no longer needed. */
+typedef struct udp_buffer
+{
+    uint8_t data[UDP_BUFFER_SIZE];
+    size_t  size;
+    void    (*release)(struct udp_buffer* buffer);
+} udp_buffer_t;
+
+/*******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+/* Implemented by udp_socket_posix.c on Linux and by udp_socket_lwip.c on the
+ * target. udp_socket_receive() does not block; it returns received payload
+ * bytes and the address of their sender, and discards what does not fit. */
+bool udp_socket_open(uint16_t port);
+bool udp_socket_send(const udp_address_t* to, udp_buffer_t* buffer);
+size_t udp_socket_receive(void* data, size_t size, udp_address_t* from);
+
+#endif /* SOURCE_UDP_SOCKET_H_ */
+
+/* [] END OF FILE */
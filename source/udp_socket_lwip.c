@@ -0,0 +1,316 @@
+/******************************************************************************
+* File Name:   udp_socket_lwip.c
+*
+* Description: This file implements the UDP socket interface on the onboard
+*              Wi-Fi radio with the Wi-Fi Connection Manager and the lwIP raw
+*              API. Datagrams are sent zero-copy: the lwIP pbuf references the
+*              caller's buffer and releases it when the driver is done with it.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include "config.h"
+
+#if IM_ENABLE_WIFI
+
+#include <string.h>
+#include "cyhal.h"
+#include "cy_wcm.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcpip.h"
+#include "lwip/udp.h"
+#include "udp_socket.h"
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define UDP_PBUF_COUNT              (8u)
+/* Maximum number of datagrams queued in lwIP at once */
+#define UDP_RX_RING_SIZE            (512u)
+/* Must be a power of two. Holds received command datagrams. */
+#define WIFI_CONNECT_RETRIES        (3u)
+/* Number of attempts to join the access point */
+
+
+/*******************************************************************************
+* Local Type Declarations
+*******************************************************************************/
+/* A custom pbuf referencing a udp_buffer_t. pbuf must be the first member,
+ * so the pbuf pointer passed to the free function can be cast back. */
+typedef struct
+{
+    struct pbuf_custom pbuf;
+    udp_buffer_t*      buffer;
+    volatile bool      used;
+} udp_pbuf_t;
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+static struct udp_pcb*   udp_pcb = NULL;
+static udp_pbuf_t        udp_pbufs[UDP_PBUF_COUNT];
+
+/* Received payload, written by the lwIP thread and read by
+ * udp_socket_receive(). The indices run freely and are masked on access. */
+static uint8_t           rx_ring[UDP_RX_RING_SIZE];
+static volatile uint32_t rx_read_index = 0;
+static volatile uint32_t rx_write_index = 0;
+static udp_address_t     rx_from;
+
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static void udp_socket_recv_callback(void* arg, struct udp_pcb* pcb, struct pbuf* p,
+                                     const ip_addr_t* addr, u16_t port);
+static void udp_socket_pbuf_free(struct pbuf* p);
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: udp_socket_open
+********************************************************************************
+* Summary:
+*  Joins the access point given by WIFI_SSID and WIFI_PASSWORD in config.h
+*  and opens a UDP socket bound to the given port.
+*
+* Parameters:
+*  port: local port
+*
+* Return:
+*  True if the socket was opened.
+*
+*******************************************************************************/
+bool udp_socket_open(uint16_t port)
+{
+    cy_rslt_t result;
+    cy_wcm_config_t wcm_config = { .interface = CY_WCM_INTERFACE_TYPE_STA };
+    cy_wcm_connect_params_t connect_params;
+    cy_wcm_ip_address_t ip_address;
+
+    result = cy_wcm_init(&wcm_config);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        return false;
+    }
+
+    memset(&connect_params, 0, sizeof(connect_params));
+    memcpy(connect_params.ap_credentials.SSID, WIFI_SSID, sizeof(WIFI_SSID));
+    memcpy(connect_params.ap_credentials.password, WIFI_PASSWORD, sizeof(WIFI_PASSWORD));
+    connect_params.ap_credentials.security = WIFI_SECURITY;
+
+    for (uint32_t i = 0; i < WIFI_CONNECT_RETRIES; i++)
+    {
+        result = cy_wcm_connect_ap(&connect_params, &ip_address);
+        if (result == CY_RSLT_SUCCESS)
+        {
+            break;
+        }
+    }
+    if (result != CY_RSLT_SUCCESS)
+    {
+        return false;
+    }
+
+    LOCK_TCPIP_CORE();
+    udp_pcb = udp_new();
+    if (udp_pcb != NULL)
+    {
+        udp_bind(udp_pcb, IP_ADDR_ANY, port);
+        udp_recv(udp_pcb, udp_socket_recv_callback, NULL);
+    }
+    UNLOCK_TCPIP_CORE();
+
+    return udp_pcb != NULL;
+}
+
+/*******************************************************************************
+* Function Name: udp_socket_send
+********************************************************************************
+* Summary:
+*  Queues the buffer as one datagram without copying it. The buffer is
+*  released once lwIP and the Wi-Fi driver are done with it, which may be
+*  before or after this function returns.
+*
+* Parameters:
+*  to: destination address
+*  buffer: the datagram; ownership passes to the socket
+*
+* Return:
+*  True if the datagram was queued; false if it was dropped.
+*
+*******************************************************************************/
+bool udp_socket_send(const udp_address_t* to, udp_buffer_t* buffer)
+{
+    udp_pbuf_t* up = NULL;
+    err_t err = ERR_CONN;
+
+    LOCK_TCPIP_CORE();
+    for (uint32_t i = 0; i < UDP_PBUF_COUNT && up == NULL; i++)
+    {
+        if (!udp_pbufs[i].used)
+        {
+            up = &udp_pbufs[i];
+        }
+    }
+    if (up != NULL && udp_pcb != NULL)
+    {
+        ip_addr_t addr;
+        struct pbuf* p;
+
+        up->used = true;
+        up->buffer = buffer;
+        up->pbuf.custom_free_function = udp_socket_pbuf_free;
+        /* The payload starts at the start of the buffer; lwIP chains a pbuf
+         * of its own for the UDP and IP headers in front of it */
+        p = pbuf_alloced_custom(PBUF_RAW, buffer->size, PBUF_REF, &up->pbuf,
+                                buffer->data, sizeof(buffer->data));
+        if (p != NULL)
+        {
+            ip_addr_set_ip4_u32(&addr, lwip_htonl(to->ip));
+            err = udp_sendto(udp_pcb, p, &addr, to->port);
+
+            /* Drop our reference; the buffer is released with the last one */
+            pbuf_free(p);
+        }
+        else
+        {
+            up->used = false;
+            buffer->release(buffer);
+        }
+    }
+    else
+    {
+        buffer->release(buffer);
+    }
+    UNLOCK_TCPIP_CORE();
+
+    return err == ERR_OK;
+}
+
+/*******************************************************************************
+* Function Name: udp_socket_receive
+********************************************************************************
+* Summary:
+*  Reads received payload bytes, if any. Datagram boundaries are not kept.
+*  This function does not block.
+*
+* Parameters:
+*  data: pointer to buffer where the payload will be stored
+*  size: buffer size
+*  from: where the address of the most recent sender will be stored
+*
+* Return:
+*  The number of bytes received; 0 if no bytes were available.
+*
+*******************************************************************************/
+size_t udp_socket_receive(void* data, size_t size, udp_address_t* from)
+{
+    uint8_t* d = (uint8_t*)data;
+    size_t count = 0;
+
+    while (count < size && rx_read_index != rx_write_index)
+    {
+        d[count++] = rx_ring[rx_read_index & (UDP_RX_RING_SIZE - 1)];
+        rx_read_index++;
+    }
+    if (count > 0)
+    {
+        uint32_t state = cyhal_system_critical_section_enter();
+        *from = rx_from;
+        cyhal_system_critical_section_exit(state);
+    }
+    return count;
+}
+
+/*******************************************************************************
+* Function Name: udp_socket_recv_callback
+********************************************************************************
+* Summary:
+*  lwIP receive callback, called from the lwIP thread for every datagram.
+*  Copies the payload into the RX ring; whatever does not fit is dropped.
+*
+*******************************************************************************/
+static void udp_socket_recv_callback(void* arg, struct udp_pcb* pcb, struct pbuf* p,
+                                     const ip_addr_t* addr, u16_t port)
+{
+    (void)arg;
+    (void)pcb;
+
+    for (struct pbuf* q = p; q != NULL; q = q->next)
+    {
+        const uint8_t* payload = (const uint8_t*)q->payload;
+        for (u16_t i = 0; i < q->len; i++)
+        {
+            if (rx_write_index - rx_read_index == UDP_RX_RING_SIZE)
+            {
+                break;
+            }
+            rx_ring[rx_write_index & (UDP_RX_RING_SIZE - 1)] = payload[i];
+            rx_write_index++;
+        }
+    }
+
+    uint32_t state = cyhal_system_critical_section_enter();
+    rx_from.ip = lwip_ntohl(ip4_addr_get_u32(ip_2_ip4(addr)));
+    rx_from.port = port;
+    cyhal_system_critical_section_exit(state);
+
+    pbuf_free(p);
+}
+
+/*******************************************************************************
+* Function Name: udp_socket_pbuf_free
+********************************************************************************
+* Summary:
+*  Called by lwIP when the last reference to a sent datagram is dropped.
+*  Hands the buffer back to its owner.
+*
+*******************************************************************************/
+static void udp_socket_pbuf_free(struct pbuf* p)
+{
+    udp_pbuf_t* up = (udp_pbuf_t*)p;
+    udp_buffer_t* buffer = up->buffer;
+
+    up->used = false;
+    buffer->release(buffer);
+}
+
+#endif /* IM_ENABLE_WIFI */
+
+/* [] END OF FILE */
@@ -0,0 +1,162 @@
+/******************************************************************************
+* File Name:   udp_socket_posix.c
+*
+* Description: This file implements the UDP socket interface with BSD sockets,
+*              for building and testing the UDP transport on Linux.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifdef __linux__
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "udp_socket.h"
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+static int udp_fd = -1;
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: udp_socket_open
+********************************************************************************
+* Summary:
+*  Opens a non-blocking UDP socket bound to the given port on all interfaces.
+*
+* Parameters:
+*  port: local port
+*
+* Return:
+*  True if the socket was opened.
+*
+*******************************************************************************/
+bool udp_socket_open(uint16_t port)
+{
+    struct sockaddr_in addr;
+
+    udp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (udp_fd < 0)
+    {
+        return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(udp_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        close(udp_fd);
+        udp_fd = -1;
+        return false;
+    }
+
+    fcntl(udp_fd, F_SETFL, fcntl(udp_fd, F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: udp_socket_send
+********************************************************************************
+* Summary:
+*  Sends the buffer as one datagram. The kernel copies the data, so the
+*  buffer is released before this function returns.
+*
+* Parameters:
+*  to: destination address
+*  buffer: the datagram; ownership passes to the socket
+*
+* Return:
+*  True if the datagram was sent; false if it was dropped.
+*
+*******************************************************************************/
+bool udp_socket_send(const udp_address_t* to, udp_buffer_t* buffer)
+{
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(to->ip);
+    addr.sin_port = htons(to->port);
+    ssize_t size = buffer->size;
+    ssize_t sent = sendto(udp_fd, buffer->data, size, 0, (struct sockaddr*)&addr, sizeof(addr));
+
+    buffer->release(buffer);
+    return sent == size;
+}
+
+/*******************************************************************************
+* Function Name: udp_socket_receive
+********************************************************************************
+* Summary:
+*  Reads one received datagram, if any. This function does not block.
+*
+* Parameters:
+*  data: pointer to buffer where the payload will be stored
+*  size: buffer size; the rest of a longer datagram is discarded
+*  from: where the source address will be stored
+*
+* Return:
+*  The number of bytes received; 0 if no datagram was available.
+*
+*******************************************************************************/
+size_t udp_socket_receive(void* data, size_t size, udp_address_t* from)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+
+    ssize_t received = recvfrom(udp_fd, data, size, 0, (struct sockaddr*)&addr, &addr_len);
+    if (received <= 0)
+    {
+        return 0;
+    }
+
+    from->ip = ntohl(addr.sin_addr.s_addr);
+    from->port = ntohs(addr.sin_port);
+    return received;
+}
+
+#endif /* __linux__ */
+
+/* [] END OF FILE */
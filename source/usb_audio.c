@@ -0,0 +1,297 @@
+/******************************************************************************
+* File Name:   usb_audio.c
+*
+* Description: USB Audio Class 1 microphone. Exposes the PDM stream on an
+*              isochronous IN endpoint next to the CDC interface, so any
+*              host audio stack can capture it with fixed latency.
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include "config.h"
+
+#if defined(COMPONENT_USBD_BASE) && IM_ENABLE_USB_AUDIO
+
+#include <string.h>
+#include "cyhal.h"
+#include "audio.h"
+#include "usb_audio.h"
+#include "USB.h"
+#include "USB_Audio.h"
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define USB_AUDIO_SAMPLES_PER_PACKET    (PDM_SAMPLE_RATE / 1000u)
+/* One isochronous packet per 1 ms frame */
+#define USB_AUDIO_FIFO_SIZE             (2u * FRAME_SIZE)
+/* Must be a power of two. Samples between the PDM frames and the endpoint. */
+#define USB_AUDIO_PREFILL               (FRAME_SIZE)
+/* The PDM delivers a frame at a time, so streaming (re)starts only when a
+ * full frame is buffered. This is the added latency. */
+
+
+/*******************************************************************************
+* Local Variables
+*******************************************************************************/
+static USB_AUDIO_HANDLE  usb_audioHandle;
+static bool              usb_audio_added = false;
+static volatile bool     usb_audio_prefilling = true;
+static usb_audio_stats_t usb_audio_stats;
+
+/* FIFO of PCM samples. The indices run freely and are masked on access.
+ * usb_audio_write() is the only writer, the IN callback the only reader. */
+static int16_t           usb_audio_fifo[USB_AUDIO_FIFO_SIZE];
+static volatile uint32_t usb_audio_read_index = 0;
+static volatile uint32_t usb_audio_write_index = 0;
+
+
+/*******************************************************************************
+* Local Function Prototypes
+*******************************************************************************/
+static void usb_audio_on_in(void* context, const U8** next_buffer, U32* next_size);
+static int usb_audio_on_control(void* context, U8 event, U8 unit, U8 control,
+                                U8* buffer, U32 size, U8 interface, U8 alt_setting);
+
+
+/*******************************************************************************
+* Function Definitions
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name: usb_audio_add
+********************************************************************************
+* Summary:
+*  Adds the USB Audio Class microphone interface and its isochronous IN
+*  endpoint. Call this after USBD_Init() and before USBD_Start().
+*
+*******************************************************************************/
+void usb_audio_add(void)
+{
+    /* Mono, 16 bit, at the PDM sample rate */
+    static const USB_AUDIO_FORMAT     mic_format = { 1, 2, 16, PDM_SAMPLE_RATE };
+    static const USB_AUDIO_IF_CONFIGS audio_config =
+    {
+        .NumFormatsMic      = 1,
+        .paFormatsMic       = &mic_format,
+        .TotalNrChannelsMic = 1,
+    };
+    USB_AUDIO_INIT_DATA InitData;
+    USB_ADD_EP_INFO     EPIsoIn;
+
+    memset(&InitData, 0, sizeof(InitData));
+    EPIsoIn.Flags          = 0;                             /* Flags not used */
+    EPIsoIn.InDir          = USB_DIR_IN;                    /* IN direction (Device to Host) */
+    EPIsoIn.Interval       = 8;                             /* Interval of 1 ms (8 * 125us) */
+    EPIsoIn.MaxPacketSize  = USB_AUDIO_SAMPLES_PER_PACKET * sizeof(int16_t); /* One frame of samples */
+    EPIsoIn.TransferType   = USB_TRANSFER_TYPE_ISO;         /* Endpoint type - Isochronous */
+    InitData.EPIn          = USBD_AddEPEx(&EPIsoIn, NULL, 0);
+
+    InitData.pfOnIn        = usb_audio_on_in;
+    InitData.pfOnGetSet    = usb_audio_on_control;
+    InitData.pAudioConfig  = &audio_config;
+
+    usb_audioHandle = USBD_AUDIO_Add(&InitData);
+    usb_audio_added = true;
+}
+
+/*******************************************************************************
+* Function Name: usb_audio_write
+********************************************************************************
+* Summary:
+*  Queues PCM samples for the isochronous endpoint. Samples that do not fit
+*  are dropped and counted as overruns. Does nothing if the audio interface
+*  was not added.
+*
+* Parameters:
+*  samples: pointer to the samples
+*  count: number of samples
+*
+*******************************************************************************/
+void usb_audio_write(const int16_t* samples, size_t count)
+{
+    if (!usb_audio_added)
+    {
+        return;
+    }
+
+    uint32_t write_index = usb_audio_write_index;
+    size_t space = USB_AUDIO_FIFO_SIZE - (write_index - usb_audio_read_index);
+    if (count > space)
+    {
+        usb_audio_stats.overruns += count - space;
+        count = space;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        usb_audio_fifo[write_index++ & (USB_AUDIO_FIFO_SIZE - 1)] = samples[i];
+    }
+
+    /* Publish the samples to the IN callback */
+    uint32_t state = cyhal_system_critical_section_enter();
+    usb_audio_write_index = write_index;
+    cyhal_system_critical_section_exit(state);
+}
+
+/*******************************************************************************
+* Function Name: usb_audio_get_stats
+********************************************************************************
+* Summary:
+*  Returns the isochronous streaming statistics.
+*
+* Parameters:
+*  stats: pointer to where the statistics will be stored
+*
+*******************************************************************************/
+void usb_audio_get_stats(usb_audio_stats_t* stats)
+{
+    uint32_t state = cyhal_system_critical_section_enter();
+    *stats = usb_audio_stats;
+    cyhal_system_critical_section_exit(state);
+}
+
+/*******************************************************************************
+* Function Name: usb_audio_on_in
+********************************************************************************
+* Summary:
+*  Called from the USB interrupt once per frame to provide the next
+*  isochronous packet. Sends silence while the FIFO is being (re)filled.
+*
+* Parameters:
+*  context: not used
+*  next_buffer: where to store a pointer to the packet
+*  next_size: where to store the packet size in bytes
+*
+*******************************************************************************/
+static void usb_audio_on_in(void* context, const U8** next_buffer, U32* next_size)
+{
+    /* Two packets, so the one being sent is not overwritten */
+    static int16_t  packets[2][USB_AUDIO_SAMPLES_PER_PACKET];
+    static uint32_t packet_index = 0;
+    (void)context;
+
+    int16_t* packet = packets[packet_index];
+    packet_index ^= 1;
+
+    uint32_t level = usb_audio_write_index - usb_audio_read_index;
+    if (usb_audio_prefilling && level >= USB_AUDIO_PREFILL)
+    {
+        usb_audio_prefilling = false;
+    }
+
+    if (!usb_audio_prefilling && level >= USB_AUDIO_SAMPLES_PER_PACKET)
+    {
+        for (uint32_t i = 0; i < USB_AUDIO_SAMPLES_PER_PACKET; i++)
+        {
+            packet[i] = usb_audio_fifo[usb_audio_read_index++ & (USB_AUDIO_FIFO_SIZE - 1)];
+        }
+    }
+    else
+    {
+        if (!usb_audio_prefilling)
+        {
+            /* Ran dry; wait for a full frame again */
+            usb_audio_stats.underruns++;
+            usb_audio_prefilling = true;
+        }
+        memset(packet, 0, sizeof(packets[0]));
+    }
+
+    usb_audio_stats.packets++;
+    *next_buffer = (const U8*)packet;
+    *next_size = sizeof(packets[0]);
+}
+
+/*******************************************************************************
+* Function Name: usb_audio_on_control
+********************************************************************************
+* Summary:
+*  Audio class control handler. Starts and stops the isochronous stream when
+*  the host opens and closes the microphone, and answers the queries of the
+*  sampling frequency, which is fixed, and of mute, which is always off.
+*  Volume controls are not supported.
+*
+* Return:
+*  0 if the request was handled, 1 otherwise.
+*
+*******************************************************************************/
+static int usb_audio_on_control(void* context, U8 event, U8 unit, U8 control,
+                                U8* buffer, U32 size, U8 interface, U8 alt_setting)
+{
+    (void)context;
+    (void)unit;
+    (void)interface;
+    (void)alt_setting;
+
+    switch (event)
+    {
+    case USB_AUDIO_RECORD_START:
+        /* Play is the device to host direction in emUSB */
+        usb_audio_prefilling = true;
+        USBD_AUDIO_Start_Play(usb_audioHandle, NULL);
+        return 0;
+    case USB_AUDIO_RECORD_STOP:
+        USBD_AUDIO_Stop_Play(usb_audioHandle);
+        return 0;
+    case USB_AUDIO_GET_CUR:
+        /* The sampling frequency is 3 bytes, mute 1 byte */
+        if (control == USB_AUDIO_SAMPLING_FREQ_CONTROL && size >= 3)
+        {
+            buffer[0] = (U8)PDM_SAMPLE_RATE;
+            buffer[1] = (U8)(PDM_SAMPLE_RATE >> 8);
+            buffer[2] = (U8)(PDM_SAMPLE_RATE >> 16);
+            return 0;
+        }
+        if (control == USB_AUDIO_MUTE_CONTROL && size >= 1)
+        {
+            buffer[0] = 0;
+            return 0;
+        }
+        return 1;
+    case USB_AUDIO_SET_CUR:
+        /* Accept the sampling frequency the microphone runs at */
+        if (control == USB_AUDIO_SAMPLING_FREQ_CONTROL && size >= 3 &&
+            (buffer[0] | (buffer[1] << 8) | ((uint32_t)buffer[2] << 16)) == PDM_SAMPLE_RATE)
+        {
+            return 0;
+        }
+        return 1;
+    default:
+        return 1;
+    }
+}
+
+#endif /* COMPONENT_USBD_BASE && IM_ENABLE_USB_AUDIO */
+
+/* [] END OF FILE */
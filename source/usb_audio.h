@@ -0,0 +1,60 @@
+/******************************************************************************
+* File Name:   usb_audio.h
+*
+*******************************************************************************
+* Copyright 2024, Cypress Semiconductor Corporation (an Infineon company) or
+* an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+*
+* This software, including source code, documentation and related
+* materials ("Software") is owned by Cypress Semiconductor Corporation
+* or one of its affiliates ("Cypress") and is protected by and subject to
+* worldwide patent protection (United States and foreign),
+* United States copyright laws and international treaty provisions.
+* Therefore, you may use this Software only as provided in the license
+* agreement accompanying the software package from which you
+* obtained this Software ("EULA").
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software
+* source code solely for use in connection with Cypress's
+* integrated circuit products.  Any reproduction, modification, translation,
+* compilation, or representation of this Software except as specified
+* above is prohibited without the express written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer
+* of such system or application assumes all risk of such use and in doing
+* so agrees to indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifndef SOURCE_USB_AUDIO_H_
+#define SOURCE_USB_AUDIO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+* Type Definitions
+*******************************************************************************/
+typedef struct
+{
+    uint32_t packets;     /* Isochronous packets sent */
+    uint32_t underruns;   /* Packets sent as silence because the FIFO ran dry */
+    uint32_t overruns;    /* Samples dropped because the FIFO was full */
+} usb_audio_stats_t;
+
+/*******************************************************************************
+* Function Prototypes
+*******************************************************************************/
+void usb_audio_add(void);
+void usb_audio_write(const int16_t* samples, size_t count);
+void usb_audio_get_stats(usb_audio_stats_t* stats);
+
+#endif /* SOURCE_USB_AUDIO_H_ */
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""Host side of the bench command (see PROTOCOL.md, section 2.6).
+
+Sends bench,<bytes>,<chunk> to the device, verifies the pattern of every
+chunk received on the bench channel and reports throughput and latency
+percentiles next to the device's own report.
+
+Latency is measured as the time from the device queueing a chunk to the host
+receiving it. Device and host clocks are not synchronized, so latencies are
+given relative to the fastest chunk.
+
+With --framing v2 or cobs, the device is switched to that framing first
+(see PROTOCOL.md, section 1.4), so the device report includes its cost.
+
+Usage:
+    bench_receiver.py /dev/ttyACM0 [--bytes N] [--chunk N] [--framing F]
+    bench_receiver.py udp:192.168.1.50:5005 [--bytes N] [--chunk N] [--framing F]
+"""
+
+import argparse
+import json
+import os
+import socket
+import struct
+import sys
+import time
+
+import framing
+
+BENCH_CHANNEL = ord('9')
+HEADER_SIZE = 8
+
+
+class SerialLink:
+    def __init__(self, path):
+        try:
+            import serial
+            self.port = serial.Serial(path, 1000000, timeout=0.1)
+            self.read = lambda: self.port.read(65536)
+            self.write = self.port.write
+        except ImportError:
+            # Without pyserial, open the device as a plain file (e.g. a pty)
+            self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+            os.set_blocking(self.fd, False)
+            self.write = lambda data: os.write(self.fd, data)
+
+    def read(self):
+        try:
+            time.sleep(0.001)
+            return os.read(self.fd, 65536)
+        except BlockingIOError:
+            return b''
+
+
+class UdpLink:
+    def __init__(self, host, port):
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 << 20)
+        self.sock.settimeout(0.1)
+        self.address = (host, port)
+        self.stream = b''
+        self.sequence = None
+
+    def write(self, data):
+        self.sock.sendto(data, self.address)
+
+    def read(self):
+        try:
+            datagram = self.sock.recv(2048)
+        except socket.timeout:
+            return b''
+        sequence, first = struct.unpack_from('<IH', datagram)
+        payload = datagram[6:]
+        if self.sequence is not None and sequence != self.sequence + 1:
+            # Lost datagrams; resume at the next packet start
+            payload = payload[first:] if first != 0xFFFF else b''
+        self.sequence = sequence
+        return payload
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('link', help='serial port, or udp:<host>:<port>')
+    parser.add_argument('--bytes', type=int, default=1000000)
+    parser.add_argument('--chunk', type=int, default=1024)
+    parser.add_argument('--timeout', type=float, default=60.0)
+    parser.add_argument('--framing', choices=['v1'] + sorted(framing.DECODERS), default='v1')
+    args = parser.parse_args()
+
+    if args.link.startswith('udp:'):
+        _, host, port = args.link.split(':')
+        link = UdpLink(host, int(port))
+    else:
+        link = SerialLink(args.link)
+
+    link.write(b'unsubscribe\r\n')
+    if args.framing != 'v1':
+        link.write(('framing,%s\r\n' % args.framing).encode())
+    time.sleep(0.2)
+    link.read()
+
+    link.write(('bench,%d,%d\r\n' % (args.bytes, args.chunk)).encode())
+    decoder = framing.DECODERS[args.framing]() if args.framing != 'v1' else None
+    start = time.monotonic()
+    first = None
+    buffer = b''
+    text = b''
+    latencies = []
+    received = 0
+    chunks = 0
+    errors = 0
+    report = None
+
+    def check_chunk(chunk, now):
+        nonlocal first, chunks, received, errors
+        sequence, timestamp = struct.unpack_from('<II', chunk)
+        pattern = bytes(i & 0xFF for i in range(len(chunk) - HEADER_SIZE))
+        if chunk[HEADER_SIZE:] != pattern:
+            errors += 1
+        if first is None:
+            first = now
+        latencies.append(now * 1e6 - timestamp)
+        chunks += 1
+        received += len(chunk)
+
+    while report is None and time.monotonic() - start < args.timeout:
+        data = link.read()
+        now = time.monotonic()
+        if decoder:
+            for item in decoder.feed(data):
+                if isinstance(item, framing.Packet):
+                    if item.channel == BENCH_CHANNEL - ord('0'):
+                        check_chunk(item.payload, now)
+                else:
+                    text += item
+        else:
+            buffer += data
+            while buffer:
+                if buffer[0] == ord('B') and len(buffer) >= 2 and buffer[1] == BENCH_CHANNEL:
+                    if len(buffer) < 2 + HEADER_SIZE:
+                        break
+                    sequence = struct.unpack_from('<I', buffer, 2)[0]
+                    size = min(args.chunk, max(HEADER_SIZE, args.bytes - sequence * args.chunk))
+                    if len(buffer) < size + 4:
+                        break
+                    check_chunk(buffer[2:2 + size], now)
+                    if buffer[2 + size:4 + size] != b'\r\n':
+                        errors += 1
+                    buffer = buffer[4 + size:]
+                else:
+                    # Text, or not ours, e.g. a late sensor packet
+                    end = buffer.find(b'\r\n')
+                    if end < 0:
+                        break
+                    text += buffer[:end + 2]
+                    buffer = buffer[end + 2:]
+
+        error = text.find(b'ERROR')
+        if error >= 0:
+            sys.exit(text[error:].split(b'\r\n')[0].decode())
+        begin = text.find(b'{')
+        end = text.find(b'}\r\n}\r\n', max(begin, 0))
+        if begin >= 0 and end >= 0:
+            report = json.loads(text[begin:end + 5])['bench']
+        elif begin < 0:
+            text = b''
+
+    if report is None:
+        sys.exit('No report from the device')
+
+    elapsed = time.monotonic() - first if first else 0
+    base = min(latencies) if latencies else 0
+    latencies = [(l - base) / 1000 for l in latencies]
+
+    print('Host:   %d bytes in %d chunks, %d lost, %d corrupt, %.0f bytes/s'
+          % (received, chunks, report['chunks'] - chunks, errors + (decoder.errors if decoder else 0),
+             received / elapsed if elapsed else 0))
+    if latencies:
+        print('        relative latency p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms'
+              % (percentile(latencies, 50), percentile(latencies, 90),
+                 percentile(latencies, 99), max(latencies)))
+    print('Device: %d bytes in %d chunks, %d bytes/s, send path %d us (%d us stalled), %d cycles/byte'
+          % (report['bytes'], report['chunks'], report['bytes_per_s'], report['send_us'],
+             report['stall_us'], report['cycles_per_byte']))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,330 @@
+#!/usr/bin/env python3
+"""Decoders for the binary packet framings (see PROTOCOL.md, sections 1.4 to 1.6).
+
+A decoder is fed the byte stream from the device as it arrives and returns
+the complete sensor data packets and text responses found in it. Frames
+that fail the length or CRC check are counted in `errors` and skipped; the
+decoder then resynchronizes on the next frame. The v2 and cobs decoders
+join fragmented packets (PROTOCOL.md, section 1.8); a packet with a missing
+fragment is dropped and counted in `errors`.
+
+The aligned framings return payloads as memoryviews into the received
+data instead of copies, so they can be mapped straight into arrays, e.g.
+numpy.frombuffer(packet.payload, dtype='<f4').
+
+In a protocol version 2 session (PROTOCOL.md, section 3), control_request()
+builds binary requests, and control messages arrive as packets on channel
+0, which control_parse() turns into a list of items.
+
+Run this file to measure the decoder throughput:
+    framing.py [--framing v2|cobs|align4|align8] [--size N] [--count N]
+"""
+
+import argparse
+import collections
+import struct
+import time
+import zlib
+
+V2_MAGIC = 0xB2
+V2_HEADER = struct.Struct('<BBHHBBII')
+V2_FLAG_RETRANSMIT = 0x01
+V2_FLAG_MORE_FRAGMENTS = 0x02
+
+CONTROL_CHANNEL = 0
+TLV_HEADER = struct.Struct('<BH')
+TLV_COMMAND = 0x01
+TLV_UINT = 0x02
+TLV_STRING = 0x03
+TLV_REQUEST = 0x10
+TLV_STATUS = 0x11
+TLV_NOTIFICATION = 0x12
+TLV_SENSOR = 0x22
+COMMAND_CODES = {
+    'config?': 1, 'subscribe': 2, 'unsubscribe': 3, 'heartbeat': 4, 'stats?': 5, 'framing': 6,
+    'bench': 7, 'credit': 8, 'resend': 9, 'weight': 10, 'protocol': 11,
+}
+
+Packet = collections.namedtuple('Packet', 'channel sequence timestamp payload flags index', defaults=(0, 0))
+
+
+def cobs_encode(data):
+    """Encodes data with COBS and appends the zero delimiter."""
+    out = bytearray()
+    for block in data.split(b'\0'):
+        while len(block) >= 254:
+            out += b'\xff' + block[:254]
+            block = block[254:]
+        out += bytes([len(block) + 1]) + block
+    out += b'\0'
+    return bytes(out)
+
+
+def cobs_decode(frame):
+    """Decodes one COBS frame without its delimiter."""
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame):
+            raise ValueError('invalid COBS frame')
+        out += frame[i + 1:i + code]
+        i += code
+        if code < 255 and i < len(frame):
+            out += b'\0'
+    return bytes(out)
+
+
+def v2_encode(channel, sequence, timestamp, payload, flags=0, index=0):
+    """Builds a v2 frame, as the device does."""
+    header = V2_HEADER.pack(V2_MAGIC, channel, len(payload), sequence, flags, index, timestamp, 0)[:12]
+    return header + struct.pack('<I', zlib.crc32(header + payload)) + payload
+
+
+def v2_parse(frame):
+    """Returns the packet in a complete v2 frame, or None if it is invalid."""
+    if len(frame) < V2_HEADER.size or frame[0] != V2_MAGIC:
+        return None
+    magic, channel, length, sequence, flags, index, timestamp, crc = V2_HEADER.unpack_from(frame)
+    payload = frame[V2_HEADER.size:]
+    if len(payload) != length or zlib.crc32(frame[:12] + payload) != crc:
+        return None
+    return Packet(channel, sequence, timestamp, payload, flags, index)
+
+
+def tlv_encode(items):
+    """Encodes a list of (type, value bytes) items."""
+    return b''.join(TLV_HEADER.pack(item_type, len(value)) + value for item_type, value in items)
+
+
+def tlv_decode(payload):
+    """Returns the list of (type, value bytes) items of a control message, or
+    of a sensor item."""
+    items = []
+    i = 0
+    while i + TLV_HEADER.size <= len(payload):
+        item_type, length = TLV_HEADER.unpack_from(payload, i)
+        i += TLV_HEADER.size
+        if i + length > len(payload):
+            raise ValueError('truncated item')
+        items.append((item_type, bytes(payload[i:i + length])))
+        i += length
+    return items
+
+
+def control_request(sequence, command, *args):
+    """Builds a binary request, e.g. control_request(7, 'subscribe', 2, 50)."""
+    items = [(TLV_COMMAND, bytes([COMMAND_CODES[command]]))]
+    for arg in args:
+        if isinstance(arg, str):
+            items.append((TLV_STRING, arg.encode()))
+        else:
+            items.append((TLV_UINT, struct.pack('<I', arg)))
+    return v2_encode(CONTROL_CHANNEL, sequence, 0, tlv_encode(items))
+
+
+def control_parse(packet):
+    """Returns the request sequence number, status, notification event and
+    all items of a control message; the first three are None if absent."""
+    items = tlv_decode(packet.payload)
+    fields = {item_type: value for item_type, value in items}
+    request = fields.get(TLV_REQUEST)
+    status = fields.get(TLV_STATUS)
+    event = fields.get(TLV_NOTIFICATION)
+    return (struct.unpack('<H', request)[0] if request else None,
+            status[0] if status else None,
+            event[0] if event else None,
+            items)
+
+
+class Reassembler:
+    """Joins the fragments of the packets of each channel."""
+
+    def __init__(self):
+        self.fragments = {}
+        self.errors = 0
+
+    def reassemble(self, packet):
+        """Returns the whole packet once its last fragment is passed, else None."""
+        if packet.index == 0 and not packet.flags & V2_FLAG_MORE_FRAGMENTS:
+            return packet
+        parts = self.fragments.pop(packet.channel, [])
+        if packet.index != len(parts) or (parts and parts[0].sequence != packet.sequence):
+            # A fragment went missing; drop the partial packet
+            self.errors += 1
+            if packet.index != 0:
+                return None
+            parts = []
+        parts.append(packet)
+        if packet.flags & V2_FLAG_MORE_FRAGMENTS:
+            self.fragments[packet.channel] = parts
+            return None
+        return parts[0]._replace(payload=b''.join(bytes(part.payload) for part in parts),
+                                 flags=packet.flags, index=0)
+
+
+class V2Decoder(Reassembler):
+    """Splits a v2 stream into packets and lines of text."""
+
+    def __init__(self):
+        super().__init__()
+        self.buffer = b''
+
+    def feed(self, data):
+        self.buffer += data
+        items = []
+        while self.buffer:
+            if self.buffer[0] == V2_MAGIC:
+                if len(self.buffer) < V2_HEADER.size:
+                    break
+                length = struct.unpack_from('<H', self.buffer, 2)[0]
+                if len(self.buffer) < V2_HEADER.size + length:
+                    break
+                packet = v2_parse(self.buffer[:V2_HEADER.size + length])
+                if packet is None:
+                    # Not a frame after all; look for the next one
+                    self.errors += 1
+                    self.buffer = self.buffer[1:]
+                    continue
+                packet = self.reassemble(packet)
+                if packet is not None:
+                    items.append(packet)
+                self.buffer = self.buffer[V2_HEADER.size + length:]
+            else:
+                # Text up to the end of the line or the next frame
+                end = self.buffer.find(b'\r\n')
+                if end < 0:
+                    break
+                magic = self.buffer.find(bytes([V2_MAGIC]), 0, end)
+                end = magic if magic >= 0 else end + 2
+                items.append(self.buffer[:end])
+                self.buffer = self.buffer[end:]
+        return items
+
+
+class CobsDecoder(Reassembler):
+    """Splits a COBS stream into packets and text responses."""
+
+    def __init__(self):
+        super().__init__()
+        self.buffer = b''
+
+    def feed(self, data):
+        frames = (self.buffer + data).split(b'\0')
+        self.buffer = frames.pop()
+        items = []
+        for frame in frames:
+            if not frame:
+                continue
+            try:
+                frame = cobs_decode(frame)
+            except ValueError:
+                self.errors += 1
+                continue
+            if frame[0] == V2_MAGIC:
+                packet = v2_parse(frame)
+                if packet is None:
+                    self.errors += 1
+                    continue
+                packet = self.reassemble(packet)
+                if packet is not None:
+                    items.append(packet)
+            else:
+                items.append(frame)
+        return items
+
+
+class AlignedDecoder:
+    """Splits an align4 or align8 stream into packets and lines of text."""
+
+    def __init__(self, alignment):
+        self.alignment = alignment
+        self.buffer = b''
+        self.errors = 0
+
+    def feed(self, data):
+        data = self.buffer + data
+        view = memoryview(data)
+        items = []
+        i = 0
+        while i < len(data):
+            if data[i] == ord('B') and len(data) - i >= self.alignment:
+                length = struct.unpack_from('<H', data, i + 2)[0]
+                size = self.alignment + (length + 2 + self.alignment - 1) // self.alignment * self.alignment
+                if len(data) - i < size:
+                    break
+                if data[i + size - 2:i + size] == b'\r\n':
+                    payload = view[i + self.alignment:i + self.alignment + length]
+                    items.append(Packet(data[i + 1] - ord('0'), None, None, payload))
+                    i += size
+                    continue
+                self.errors += 1
+            # Text up to the end of the line
+            end = data.find(b'\r\n', i)
+            if end < 0:
+                break
+            items.append(data[i:end + 2])
+            i = end + 2
+        self.buffer = data[i:]
+        return items
+
+
+def aligned_encode(channel, payload, alignment):
+    """Builds an aligned frame, as the device does."""
+    padding = -(len(payload) + 2) % alignment
+    header = struct.pack('<BBH', ord('B'), ord('0') + channel, len(payload))
+    return header.ljust(alignment, b'\0') + payload + b'\0' * padding + b'\r\n'
+
+
+def mux_parse(payload):
+    """Splits the payload of a combined audio and IMU packet (PROTOCOL.md,
+    section 1.7) into the audio samples and a list of (audio sample index,
+    (x, y, z)) IMU samples."""
+    audio_count, imu_count = struct.unpack_from('<HH', payload)
+    audio = struct.unpack_from('<%dh' % audio_count, payload, 4)
+    imu = []
+    for i in range(imu_count):
+        index, _, x, y, z = struct.unpack_from('<HHfff', payload, 4 + 2 * audio_count + 16 * i)
+        imu.append((index, (x, y, z)))
+    return audio, imu
+
+
+DECODERS = {
+    'v2': V2Decoder,
+    'cobs': CobsDecoder,
+    'align4': lambda: AlignedDecoder(4),
+    'align8': lambda: AlignedDecoder(8),
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Measures the decoder throughput.')
+    parser.add_argument('--framing', choices=sorted(DECODERS), default='cobs')
+    parser.add_argument('--size', type=int, default=2048, help='payload size')
+    parser.add_argument('--count', type=int, default=2000, help='number of packets')
+    args = parser.parse_args()
+
+    # Audio-like payload with zero bytes in it
+    payload = bytes((i * 37) & 0xFF if i % 7 else 0 for i in range(args.size))
+    stream = b''
+    for sequence in range(args.count):
+        if args.framing.startswith('align'):
+            stream += aligned_encode(1, payload, int(args.framing[5:]))
+            continue
+        frame = v2_encode(1, sequence & 0xFFFF, sequence * 64000, payload)
+        stream += cobs_encode(frame) if args.framing == 'cobs' else frame
+
+    decoder = DECODERS[args.framing]()
+    start = time.perf_counter()
+    packets = 0
+    for i in range(0, len(stream), 4096):
+        packets += len(decoder.feed(stream[i:i + 4096]))
+    elapsed = time.perf_counter() - start
+
+    print('%s: %d packets, %d errors, %.1f MB/s (%.1f%% overhead on the link)'
+          % (args.framing, packets, decoder.errors, len(stream) / elapsed / 1e6,
+             100.0 * (len(stream) / (args.count * args.size) - 1)))
+
+
+if __name__ == '__main__':
+    main()